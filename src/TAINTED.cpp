@@ -3,8 +3,30 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <algorithm> // для std::remove
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <limits>
+#include <queue>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -15,6 +37,7 @@ struct task {
     string due;
     string group;
     bool done = false;
+    string parent; // id родительской задачи, пусто - задача верхнего уровня
 };
 
 // ===== Вспомогательные функции для дат =====
@@ -55,6 +78,26 @@ bool isOverdue(const string& due, const string& today) {
     return d1 < d2;
 }
 
+// проверка строки даты YYYY-MM-DD целиком (формат, цифры и календарь)
+bool isValidDueDate(const string& due) {
+    if (due.size() != 10 || due[4] != '-' || due[7] != '-') return false;
+    int parts[3] = { 0, 0, 0 }; // год, месяц, день
+    int part = 0;
+    for (size_t i = 0; i < due.size(); ++i) {
+        if (i == 4 || i == 7) {
+            ++part;
+            continue;
+        }
+        if (due[i] < '0' || due[i] > '9') return false;
+        parts[part] = parts[part] * 10 + (due[i] - '0');
+    }
+    return isValidDate(parts[2], parts[1], parts[0]);
+}
+
+bool isValidPriority(const string& priority) {
+    return priority == "low" || priority == "mid" || priority == "high";
+}
+
 // ===== Экранирование строк для JSON =====
 string escapeJson(const string& s) {
     string out;
@@ -68,6 +111,267 @@ string escapeJson(const string& s) {
     return out;
 }
 
+// ===== Персистентный список задач =====
+
+// числовой id (только цифры, без ведущих нулей); false для остальных
+bool numericId(const string& id, uint64_t& value) {
+    if (id.empty() || id.size() > 18 || (id.size() > 1 && id[0] == '0')) return false;
+    value = 0;
+    for (char c : id) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Неизменяемый список задач на основе декартова дерева по неявному ключу
+// (позиция в списке). Любое изменение возвращает новый список, который
+// разделяет со старым все нетронутые узлы: копируется только путь от корня
+// до изменённой позиции, т.е. O(log N) узлов. Поэтому старые версии
+// можно хранить для отмены и отдавать как снимки для чтения.
+class TaskList {
+    struct Node;
+    using NodePtr = shared_ptr<const Node>;
+
+    struct Node {
+        task value;
+        NodePtr left;
+        NodePtr right;
+        size_t size;
+        uint32_t prio;
+        uint64_t ownId; // больший из числовых id и parent задачи, 0 - оба нечисловые
+        uint64_t maxId; // наибольший ownId в поддереве
+    };
+
+public:
+    TaskList() = default;
+
+    // сбалансированное дерево из вектора за O(N); задачи перемещаются из list
+    static TaskList fromVector(vector<task> list) {
+        TaskList result;
+        result.root = build(list, 0, list.size(), 0);
+        return result;
+    }
+
+    size_t size() const { return sizeOf(root); }
+    bool empty() const { return !root; }
+
+    // наибольший числовой id среди id и parent за O(1): новые задачи получают
+    // следующий, поэтому id, на который ещё ссылается подзадача, не выдаётся заново
+    uint64_t maxNumericId() const { return root ? root->maxId : 0; }
+
+    // true, если это одна и та же версия (а не просто равные списки)
+    bool sameVersion(const TaskList& other) const { return root == other.root; }
+
+    const task& operator[](size_t i) const {
+        const Node* n = root.get();
+        while (true) {
+            size_t leftSize = sizeOf(n->left);
+            if (i < leftSize) {
+                n = n->left.get();
+            }
+            else if (i == leftSize) {
+                return n->value;
+            }
+            else {
+                i -= leftSize + 1;
+                n = n->right.get();
+            }
+        }
+    }
+
+    TaskList set(size_t i, task value) const {
+        TaskList result;
+        result.root = setAt(root, i, std::move(value));
+        return result;
+    }
+
+    TaskList pushBack(task value) const {
+        TaskList result;
+        result.root = merge(root, makeNode(std::move(value), nullptr, nullptr, nextPriority()));
+        return result;
+    }
+
+    TaskList erase(size_t i) const {
+        NodePtr left, rest, removed, right;
+        split(root, i, left, rest);
+        split(rest, 1, removed, right);
+        TaskList result;
+        result.root = merge(left, right);
+        return result;
+    }
+
+    // обход по порядку без рекурсии
+    template <class F>
+    void forEach(F f) const {
+        forEachWhile([&f](const task& t) {
+            f(t);
+            return true;
+        });
+    }
+
+    // обход, прерываемый, когда f вернёт false; false - обход прерван
+    template <class F>
+    bool forEachWhile(F f) const {
+        vector<const Node*> stack;
+        const Node* n = root.get();
+        while (n || !stack.empty()) {
+            while (n) {
+                stack.push_back(n);
+                n = n->left.get();
+            }
+            n = stack.back();
+            stack.pop_back();
+            if (!f(n->value)) return false;
+            n = n->right.get();
+        }
+        return true;
+    }
+
+    vector<task> toVector() const {
+        vector<task> out;
+        out.reserve(size());
+        forEach([&out](const task& t) { out.push_back(t); });
+        return out;
+    }
+
+private:
+    static size_t sizeOf(const NodePtr& n) { return n ? n->size : 0; }
+
+    static uint32_t nextPriority() {
+        static mt19937 rng(random_device{}());
+        return static_cast<uint32_t>(rng());
+    }
+
+    static NodePtr makeNode(task value, NodePtr left, NodePtr right, uint32_t prio) {
+        uint64_t ownId = 0, parentId = 0;
+        if (!numericId(value.id, ownId)) ownId = 0;
+        if (numericId(value.parent, parentId)) ownId = max(ownId, parentId);
+        return makeNode(std::move(value), std::move(left), std::move(right), prio, ownId);
+    }
+
+    static NodePtr makeNode(task value, NodePtr left, NodePtr right, uint32_t prio, uint64_t ownId) {
+        size_t size = sizeOf(left) + sizeOf(right) + 1;
+        uint64_t maxId = max({ ownId, left ? left->maxId : 0, right ? right->maxId : 0 });
+        return make_shared<const Node>(Node{ std::move(value), std::move(left), std::move(right), size, prio, ownId, maxId });
+    }
+
+    static NodePtr withChildren(const NodePtr& n, NodePtr left, NodePtr right) {
+        return makeNode(n->value, std::move(left), std::move(right), n->prio, n->ownId);
+    }
+
+    // приоритеты задаются полосами по глубине: у родителя всегда больше,
+    // чем у детей, поэтому свойство кучи выполняется без сортировки
+    static NodePtr build(vector<task>& list, size_t lo, size_t hi, unsigned depth) {
+        if (lo >= hi) return nullptr;
+        size_t mid = lo + (hi - lo) / 2;
+        unsigned level = depth < 63 ? 63 - depth : 0;
+        uint32_t prio = (static_cast<uint32_t>(level) << 26) | (nextPriority() & ((1u << 26) - 1));
+        NodePtr left = build(list, lo, mid, depth + 1);
+        NodePtr right = build(list, mid + 1, hi, depth + 1);
+        return makeNode(std::move(list[mid]), std::move(left), std::move(right), prio);
+    }
+
+    static NodePtr setAt(const NodePtr& n, size_t i, task value) {
+        size_t leftSize = sizeOf(n->left);
+        if (i < leftSize) {
+            return withChildren(n, setAt(n->left, i, std::move(value)), n->right);
+        }
+        if (i == leftSize) {
+            return makeNode(std::move(value), n->left, n->right, n->prio);
+        }
+        return withChildren(n, n->left, setAt(n->right, i - leftSize - 1, std::move(value)));
+    }
+
+    // left получает первые k элементов, right - остальные
+    static void split(const NodePtr& n, size_t k, NodePtr& left, NodePtr& right) {
+        if (!n) {
+            left = right = nullptr;
+            return;
+        }
+        size_t leftSize = sizeOf(n->left);
+        if (k <= leftSize) {
+            NodePtr tail;
+            split(n->left, k, left, tail);
+            right = withChildren(n, tail, n->right);
+        }
+        else {
+            NodePtr head;
+            split(n->right, k - leftSize - 1, head, right);
+            left = withChildren(n, n->left, head);
+        }
+    }
+
+    static NodePtr merge(const NodePtr& a, const NodePtr& b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->prio > b->prio) {
+            return withChildren(a, a->left, merge(a->right, b));
+        }
+        return withChildren(b, merge(a, b->left), b->right);
+    }
+
+    NodePtr root;
+};
+
+// История версий списка: текущая версия + стеки отмены и повтора.
+// Версии разделяют узлы, поэтому каждая сохранённая версия стоит
+// столько памяти, сколько узлов изменила соответствующая правка.
+class TaskStore {
+public:
+    explicit TaskStore(TaskList initial = TaskList())
+        : cur(std::move(initial)) {}
+
+    const TaskList& current() const { return cur; }
+
+    // новая версия после правки; отменённые ранее версии забываются
+    void commit(TaskList next) {
+        undoStack.push_back(std::move(cur));
+        if (undoStack.size() > kMaxHistory) {
+            undoStack.erase(undoStack.begin());
+        }
+        redoStack.clear();
+        cur = std::move(next);
+    }
+
+    // новая версия без возможности отмены (например, после переноса задач в архив:
+    // отмена вернула бы их в рабочий список, и они оказались бы в двух местах)
+    void reset(TaskList next) {
+        undoStack.clear();
+        redoStack.clear();
+        cur = std::move(next);
+    }
+
+    bool undo() {
+        if (undoStack.empty()) return false;
+        redoStack.push_back(std::move(cur));
+        cur = std::move(undoStack.back());
+        undoStack.pop_back();
+        return true;
+    }
+
+    bool redo() {
+        if (redoStack.empty()) return false;
+        undoStack.push_back(std::move(cur));
+        cur = std::move(redoStack.back());
+        redoStack.pop_back();
+        return true;
+    }
+
+private:
+    static const size_t kMaxHistory = 1000;
+
+    TaskList cur;
+    vector<TaskList> undoStack;
+    vector<TaskList> redoStack;
+};
+
+// то же, что out << escapeJson(s), но без временной строки, если экранировать нечего
+void writeJsonEscaped(ostream& out, const string& s) {
+    if (s.find_first_of("\"\\\n") == string::npos) out.write(s.data(), static_cast<streamsize>(s.size()));
+    else out << escapeJson(s);
+}
+
 // Работа с JSON-файлом
 
 // Ожидаемый формат data.json:
@@ -79,18 +383,16 @@ string escapeJson(const string& s) {
 //         "due": "2025-12-29",
 //         "priority": "low",
 //         "group": "",
+//         "parent": "3",      <- только у подзадач
 //         "done": false
 //     },
 //     ...
 // ]
 
-void readFile(const string& name, vector<task>& list) {
-    ifstream file(name);
-    if (!file.is_open()) {
-        cerr << "Не удалось открыть файл для чтения!" << endl;
-        return;
-    }
-
+// Потоковый разбор: onTask вызывается для каждой задачи сразу после её
+// закрывающей скобки, поэтому в памяти держится только текущая задача.
+// Возвращает true, если была прочитана хотя бы одна задача.
+bool readTasksJson(istream& file, const function<void(task&)>& onTask) {
     string line;
     task T;
     int counter = 0;
@@ -110,7 +412,7 @@ void readFile(const string& name, vector<task>& list) {
         if (line.find('}') != string::npos) {
             // конец объекта
             anyTask = true;
-            list.push_back(T);
+            onTask(T);
             continue;
         }
 
@@ -206,89 +508,1918 @@ void readFile(const string& name, vector<task>& list) {
             }
             T.done = (value == "true");
         }
+        else if (line.find("\"parent\"") != string::npos) {
+            size_t colon = line.find(":");
+            if (colon == string::npos) {
+                cerr << "Ошибка JSON в строке " << line_no
+                    << ": отсутствует ':' в поле parent" << endl;
+                continue;
+            }
+            int start = static_cast<int>(colon) + 2;
+            string value = line.substr(start);
+            value.erase(remove(value.begin(), value.end(), ' '), value.end());
+            if (!value.empty() && value[0] == '\"') value.erase(0, 1);
+            if (!value.empty() && value.back() == ',') value.pop_back();
+            if (!value.empty() && value.back() == '\"') value.pop_back();
+            T.parent = value;
+        }
+    }
+
+    return anyTask;
+}
+
+void readFile(const string& name, vector<task>& list) {
+    ifstream file(name);
+    if (!file.is_open()) {
+        cerr << "Не удалось открыть файл для чтения!" << endl;
+        return;
+    }
+
+    bool anyTask = readTasksJson(file, [&list](task& T) { list.push_back(std::move(T)); });
+    if (!anyTask) {
+        cerr << "Предупреждение: файл JSON прочитан, но задач не найдено." << endl;
+    }
+
+    file.close();
+}
+
+// запись одного объекта задачи в формате data.json (без запятой и перевода строки)
+void writeTaskJsonObject(ostream& file, const task& t) {
+    file << "    {\n";
+    file << "        \"id\": \"" << escapeJson(t.id) << "\",\n";
+    file << "        \"title\": \"" << escapeJson(t.title) << "\",\n";
+    file << "        \"due\": \"" << escapeJson(t.due) << "\",\n";
+    file << "        \"priority\": \"" << escapeJson(t.priority) << "\",\n";
+    file << "        \"group\": \"" << escapeJson(t.group) << "\",\n";
+    if (!t.parent.empty()) {
+        file << "        \"parent\": \"" << escapeJson(t.parent) << "\",\n";
+    }
+    file << "        \"done\": " << (t.done ? "true" : "false") << "\n";
+    file << "    }";
+}
+
+void writeTaskJson(ostream& file, const task& t, bool last) {
+    writeTaskJsonObject(file, t);
+    if (!last) file << ",";
+    file << "\n";
+}
+
+// Полная перезапись JSON-файла (используется после любых изменений)
+// возвращает false, если файл не удалось записать
+bool saveAllTasks(const string& name, const vector<task>& list) {
+    ofstream file(name);
+    if (!file.is_open()) {
+        cerr << "Не удалось открыть файл для записи!" << endl;
+        return false;
+    }
+
+    file << "[\n";
+    for (size_t i = 0; i < list.size(); ++i) {
+        writeTaskJson(file, list[i], i + 1 == list.size());
+    }
+    file << "]\n";
+    file.close();
+    return !file.fail();
+}
+
+bool saveAllTasks(const string& name, const TaskList& list) {
+    ofstream file(name);
+    if (!file.is_open()) {
+        cerr << "Не удалось открыть файл для записи!" << endl;
+        return false;
+    }
+
+    file << "[\n";
+    size_t written = 0;
+    list.forEach([&](const task& t) {
+        ++written;
+        writeTaskJson(file, t, written == list.size());
+    });
+    file << "]\n";
+    file.close();
+    return !file.fail();
+}
+
+// Запись во временный файл и атомарная замена основного:
+// при сбое посреди записи старый data.json остаётся целым
+bool saveAllTasksAtomic(const string& name, const TaskList& list) {
+    string tmp = name + ".tmp";
+    if (!saveAllTasks(tmp, list)) {
+        return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp, name, ec);
+    if (ec) {
+        cerr << "Не удалось заменить файл " << name << ": " << ec.message() << endl;
+        filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+// ===== Фоновое сохранение =====
+
+// Поток меню публикует неизменяемую версию списка (TaskList, O(1)) и сразу продолжает работу,
+// а фоновый поток пишет файл. Если за время записи пришло несколько снимков,
+// на диск попадает только последний (серия правок -> одна запись).
+class AsyncSaver {
+public:
+    explicit AsyncSaver(const string& name)
+        : filename(name), worker(&AsyncSaver::run, this) {}
+
+    ~AsyncSaver() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    AsyncSaver(const AsyncSaver&) = delete;
+    AsyncSaver& operator=(const AsyncSaver&) = delete;
+
+    // отдать снимок на запись (не блокирует на время записи)
+    void publish(const TaskList& list) {
+        {
+            lock_guard<mutex> lock(m);
+            pending = list;
+            hasPending = true;
+        }
+        cv.notify_all();
+    }
+
+    // дождаться, пока все опубликованные снимки будут записаны
+    void flush() {
+        unique_lock<mutex> lock(m);
+        idle.wait(lock, [this] { return !hasPending && !writing; });
+    }
+
+    // ошибка последней неудачной записи (пустая строка - ошибок не было)
+    string takeError() {
+        lock_guard<mutex> lock(m);
+        string err;
+        err.swap(lastError);
+        return err;
+    }
+
+private:
+    void run() {
+        unique_lock<mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [this] { return hasPending || stopping; });
+            if (!hasPending) {
+                return; // stopping и писать нечего
+            }
+            TaskList snapshot = std::move(pending);
+            pending = TaskList();
+            hasPending = false;
+            writing = true;
+            lock.unlock();
+
+            bool ok = saveAllTasksAtomic(filename, snapshot);
+
+            lock.lock();
+            writing = false;
+            if (!ok) {
+                lastError = "Не удалось сохранить " + filename;
+            }
+            if (!hasPending) {
+                idle.notify_all();
+            }
+        }
+    }
+
+    string filename;
+    mutex m;
+    condition_variable cv;
+    condition_variable idle;
+    TaskList pending;
+    bool hasPending = false;
+    bool writing = false;
+    bool stopping = false;
+    string lastError;
+    thread worker; // объявлен последним: стартует после инициализации остальных полей
+};
+
+// ===== Потоковый импорт/экспорт (CSV, NDJSON) =====
+
+// Записи обрабатываются по одной: чтение -> разбор -> проверка -> вставка.
+// В памяти держится только текущая запись (не длиннее kMaxRecordBytes),
+// поэтому размер входного файла не ограничен объёмом памяти.
+//
+// CSV: первая строка - заголовок с именами полей (id,title,due,priority,group,done,parent),
+//      поля с запятыми, кавычками или переводами строк берутся в кавычки.
+// NDJSON: по одному JSON-объекту на строку:
+//      {"id":"1","title":"first","due":"2025-12-29","priority":"low","group":"","done":false}
+// Поле parent необязательно: при чтении его отсутствие означает задачу верхнего уровня.
+
+enum class TaskFormat { Json, Csv, Ndjson };
+
+const size_t kMaxRecordBytes = 1 << 20;
+const size_t kMaxReportedErrors = 20;
+
+// формат по расширению файла; false, если расширение неизвестно
+bool formatFromName(const string& name, TaskFormat& format) {
+    string ext = filesystem::path(name).extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    if (ext == ".json") format = TaskFormat::Json;
+    else if (ext == ".csv") format = TaskFormat::Csv;
+    else if (ext == ".ndjson" || ext == ".jsonl") format = TaskFormat::Ndjson;
+    else return false;
+    return true;
+}
+
+// Построчное чтение через собственный буфер (перевод строки ищется memchr).
+// Строка длиннее limit обрезается, остаток пропускается, а truncated
+// выставляется в true. next возвращает false в конце файла.
+class LineReader {
+public:
+    explicit LineReader(istream& in)
+        : in(in), buf(1 << 16) {}
+
+    bool next(string& line, size_t limit, bool& truncated) {
+        line.clear();
+        truncated = false;
+        bool any = false;
+        while (true) {
+            if (pos == end && !fill()) {
+                break;
+            }
+            any = true;
+            const char* start = buf.data() + pos;
+            const char* nl = static_cast<const char*>(memchr(start, '\n', end - pos));
+            size_t len = nl ? static_cast<size_t>(nl - start) : end - pos;
+            size_t room = limit > line.size() ? limit - line.size() : 0;
+            if (len > room) truncated = true;
+            line.append(start, min(len, room));
+            pos += len;
+            if (nl) {
+                ++pos;
+                break;
+            }
+        }
+        if (!any) return false;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+
+private:
+    bool fill() {
+        in.read(buf.data(), static_cast<streamsize>(buf.size()));
+        pos = 0;
+        end = static_cast<size_t>(in.gcount());
+        return end > 0;
+    }
+
+    istream& in;
+    vector<char> buf;
+    size_t pos = 0;
+    size_t end = 0;
+};
+
+// ---- CSV ----
+
+// Разбор одной CSV-записи; запись в кавычках может занимать несколько строк.
+// line_no - счётчик прочитанных строк (после вызова - номер последней строки
+// записи), first_line - номер первой строки записи (для сообщений об ошибках).
+// Возвращает false в конце файла; error заполняется для битой записи.
+bool readCsvRecord(LineReader& in, vector<string>& fields, size_t& line_no, size_t& first_line, string& error) {
+    fields.clear();
+    error.clear();
+    string line;
+    bool truncated = false;
+    if (!in.next(line, kMaxRecordBytes, truncated)) return false;
+    ++line_no;
+    first_line = line_no;
+    size_t extraLines = 0;
+    size_t recordBytes = line.size();
+
+    string field;
+    bool inQuotes = false;
+    size_t i = 0;
+    while (true) {
+        if (i == line.size()) {
+            if (!inQuotes) break;
+            // перевод строки внутри кавычек - часть значения
+            if (!in.next(line, kMaxRecordBytes, truncated)) {
+                error = "незакрытая кавычка в конце файла";
+                break;
+            }
+            ++extraLines;
+            recordBytes += line.size() + 1;
+            if (recordBytes > kMaxRecordBytes) {
+                error = "запись длиннее " + to_string(kMaxRecordBytes) + " байт";
+                break;
+            }
+            field += '\n';
+            i = 0;
+            continue;
+        }
+        char c = line[i++];
+        if (inQuotes) {
+            if (c == '"') {
+                if (i < line.size() && line[i] == '"') {
+                    field += '"';
+                    ++i;
+                }
+                else {
+                    inQuotes = false;
+                }
+            }
+            else {
+                field += c;
+            }
+        }
+        else if (c == '"') {
+            inQuotes = true;
+        }
+        else if (c == ',') {
+            fields.push_back(std::move(field));
+            field.clear();
+        }
+        else {
+            field += c;
+        }
+    }
+    fields.push_back(std::move(field));
+    if (truncated && error.empty()) {
+        error = "запись длиннее " + to_string(kMaxRecordBytes) + " байт";
+    }
+    line_no += extraLines;
+    return true;
+}
+
+string csvField(const string& value) {
+    if (value.find_first_of(",\"\n\r") == string::npos) return value;
+    string out = "\"";
+    for (char c : value) {
+        if (c == '"') out += "\"\"";
+        else out += c;
+    }
+    out += '"';
+    return out;
+}
+
+const char* const kCsvHeader = "id,title,due,priority,group,done,parent";
+
+void writeTaskCsv(ostream& out, const task& t) {
+    out << csvField(t.id) << ',' << csvField(t.title) << ',' << csvField(t.due) << ','
+        << csvField(t.priority) << ',' << csvField(t.group) << ','
+        << (t.done ? "true" : "false") << ',' << csvField(t.parent) << '\n';
+}
+
+// ---- NDJSON ----
+
+void appendUtf8(string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    }
+    else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+bool readHex4(const string& s, size_t& i, unsigned& code) {
+    if (i + 4 > s.size()) return false;
+    code = 0;
+    for (size_t k = 0; k < 4; ++k) {
+        char c = s[i++];
+        code <<= 4;
+        if (c >= '0' && c <= '9') code |= c - '0';
+        else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+// строка JSON начиная с открывающей кавычки s[i]; i сдвигается за закрывающую
+bool parseJsonString(const string& s, size_t& i, string& out) {
+    out.clear();
+    ++i;
+    while (i < s.size()) {
+        // обычные символы копируем куском до ближайшей кавычки или '\\'
+        size_t plain = i;
+        while (plain < s.size() && s[plain] != '"' && s[plain] != '\\') ++plain;
+        out.append(s, i, plain - i);
+        i = plain;
+        if (i >= s.size()) return false;
+        char c = s[i++];
+        if (c == '"') return true;
+        if (i >= s.size()) return false;
+        char e = s[i++];
+        switch (e) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            unsigned code = 0;
+            if (!readHex4(s, i, code)) return false;
+            if (code >= 0xD800 && code < 0xDC00 && i + 1 < s.size() && s[i] == '\\' && s[i + 1] == 'u') {
+                size_t j = i + 2;
+                unsigned low = 0;
+                if (readHex4(s, j, low) && low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i = j;
+                }
+            }
+            appendUtf8(out, code);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// Разбор плоского JSON-объекта в одну строку. Значения-строки декодируются,
+// остальные (true/false/числа/null) возвращаются как есть. Строки в fields
+// переиспользуются между вызовами, чтобы не выделять память на каждую запись.
+bool parseJsonObjectLine(const string& line, vector<pair<string, string>>& fields, string& error) {
+    size_t count = 0;
+    auto finish = [&](bool ok) {
+        fields.resize(count);
+        return ok;
+    };
+    size_t i = 0;
+    auto skipSpaces = [&]() {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) ++i;
+    };
+    skipSpaces();
+    if (i >= line.size() || line[i] != '{') {
+        error = "ожидается '{'";
+        return finish(false);
+    }
+    ++i;
+    skipSpaces();
+    if (i < line.size() && line[i] == '}') return finish(true);
+    while (true) {
+        skipSpaces();
+        if (count == fields.size()) fields.emplace_back();
+        string& key = fields[count].first;
+        string& value = fields[count].second;
+        if (i >= line.size() || line[i] != '"' || !parseJsonString(line, i, key)) {
+            error = "ожидается имя поля в кавычках";
+            return finish(false);
+        }
+        skipSpaces();
+        if (i >= line.size() || line[i] != ':') {
+            error = "отсутствует ':' после поля " + key;
+            return finish(false);
+        }
+        ++i;
+        skipSpaces();
+        if (i < line.size() && line[i] == '"') {
+            if (!parseJsonString(line, i, value)) {
+                error = "некорректная строка в поле " + key;
+                return finish(false);
+            }
+        }
+        else {
+            size_t start = i;
+            while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ' ') ++i;
+            value.assign(line, start, i - start);
+            if (value.empty()) {
+                error = "отсутствует значение поля " + key;
+                return finish(false);
+            }
+        }
+        ++count;
+        skipSpaces();
+        if (i < line.size() && line[i] == ',') {
+            ++i;
+            continue;
+        }
+        if (i < line.size() && line[i] == '}') {
+            ++i;
+            skipSpaces();
+            if (i != line.size()) {
+                error = "лишние символы после '}'";
+                return finish(false);
+            }
+            return finish(true);
+        }
+        error = "ожидается ',' или '}'";
+        return finish(false);
+    }
+}
+
+void writeTaskNdjson(ostream& out, const task& t) {
+    out << "{\"id\":\"";
+    writeJsonEscaped(out, t.id);
+    out << "\",\"title\":\"";
+    writeJsonEscaped(out, t.title);
+    out << "\",\"due\":\"";
+    writeJsonEscaped(out, t.due);
+    out << "\",\"priority\":\"";
+    writeJsonEscaped(out, t.priority);
+    out << "\",\"group\":\"";
+    writeJsonEscaped(out, t.group);
+    out << "\",\"done\":" << (t.done ? "true" : "false");
+    if (!t.parent.empty()) {
+        out << ",\"parent\":\"";
+        writeJsonEscaped(out, t.parent);
+        out << '"';
+    }
+    out << "}\n";
+}
+
+// ---- общий конвейер ----
+
+// заполнение поля задачи по имени; false для значения done, отличного от true/false
+bool setTaskField(task& t, const string& key, const string& value, string& error) {
+    if (key == "id") t.id = value;
+    else if (key == "title") t.title = value;
+    else if (key == "due") t.due = value;
+    else if (key == "priority") t.priority = value;
+    else if (key == "group") t.group = value;
+    else if (key == "parent") t.parent = value;
+    else if (key == "done") {
+        if (value != "true" && value != "false" && !value.empty()) {
+            error = "ожидается true/false в поле done, найдено '" + value + "'";
+            return false;
+        }
+        t.done = (value == "true");
+    }
+    // неизвестные поля пропускаем
+    return true;
+}
+
+// те же правила, что и при вводе с клавиатуры
+bool validateTask(const task& t, string& error) {
+    if (!isValidPriority(t.priority)) {
+        error = "неверный приоритет '" + t.priority + "', допустимо: low, mid, high";
+        return false;
+    }
+    if (!isValidDueDate(t.due)) {
+        error = "некорректная дата '" + t.due + "', ожидается YYYY-MM-DD";
+        return false;
+    }
+    return true;
+}
+
+struct ImportStats {
+    size_t imported = 0;
+    size_t rejected = 0;
+};
+
+// Потоковый импорт: каждая корректная задача передаётся в sink, о каждой
+// отклонённой записи сообщается с номером строки (для JSON - с порядковым
+// номером объекта), выводятся первые kMaxReportedErrors. Непустой source
+// (имя входного файла) добавляется в начало каждого сообщения.
+ImportStats importTasks(istream& in, TaskFormat format, const function<void(task&)>& sink,
+    const string& source = "") {
+    ImportStats stats;
+    // data.json разбирается построчно, номера строк объектов не сохраняются
+    string where = format == TaskFormat::Json ? "Запись " : "Строка ";
+    if (!source.empty()) where = source + ": " + where;
+    auto reject = [&stats, &where](size_t line_no, const string& error) {
+        if (stats.rejected < kMaxReportedErrors) {
+            // одной операцией вывода: при слиянии входы читаются параллельно
+            cerr << where + to_string(line_no) + ": " + error + ", запись пропущена\n" << flush;
+        }
+        else if (stats.rejected == kMaxReportedErrors) {
+            cerr << "Дальнейшие ошибки не выводятся..." << endl;
+        }
+        ++stats.rejected;
+    };
+    auto accept = [&](task& t, size_t line_no) {
+        string error;
+        if (!validateTask(t, error)) {
+            reject(line_no, error);
+            return;
+        }
+        sink(t);
+        ++stats.imported;
+    };
+
+    string error;
+    if (format == TaskFormat::Json) {
+        size_t record_no = 0;
+        readTasksJson(in, [&](task& t) { accept(t, ++record_no); });
+    }
+    else if (format == TaskFormat::Csv) {
+        LineReader lines(in);
+        size_t line_no = 0;
+        size_t first_line = 0;
+        vector<string> header, fields;
+        if (!readCsvRecord(lines, header, line_no, first_line, error)) {
+            return stats; // пустой файл
+        }
+        while (readCsvRecord(lines, fields, line_no, first_line, error)) {
+            if (!error.empty()) {
+                reject(first_line, error);
+                continue;
+            }
+            if (fields.size() == 1 && fields[0].empty()) continue; // пустая строка
+            if (fields.size() != header.size()) {
+                reject(first_line, "ожидается полей: " + to_string(header.size()) + ", найдено: " + to_string(fields.size()));
+                continue;
+            }
+            task t;
+            bool ok = true;
+            for (size_t k = 0; k < fields.size() && ok; ++k) {
+                ok = setTaskField(t, header[k], fields[k], error);
+            }
+            if (!ok) {
+                reject(first_line, error);
+                continue;
+            }
+            accept(t, first_line);
+        }
+    }
+    else {
+        LineReader lines(in);
+        size_t line_no = 0;
+        string line;
+        bool truncated = false;
+        vector<pair<string, string>> fields;
+        while (lines.next(line, kMaxRecordBytes, truncated)) {
+            ++line_no;
+            if (truncated) {
+                reject(line_no, "запись длиннее " + to_string(kMaxRecordBytes) + " байт");
+                continue;
+            }
+            if (line.find_first_not_of(" \t") == string::npos) continue;
+            if (!parseJsonObjectLine(line, fields, error)) {
+                reject(line_no, error);
+                continue;
+            }
+            task t;
+            bool ok = true;
+            for (size_t k = 0; k < fields.size() && ok; ++k) {
+                ok = setTaskField(t, fields[k].first, fields[k].second, error);
+            }
+            if (!ok) {
+                reject(line_no, error);
+                continue;
+            }
+            accept(t, line_no);
+        }
+    }
+    return stats;
+}
+
+// Добавление импортированных задач в конец списка. Пустой или уже занятый id
+// (в списке или раньше в том же импорте) получает новый номер больше всех
+// числовых id и parent списка и импорта; parent импортированных задач,
+// ссылавшийся на заменённый id, переписывается на новый номер.
+TaskList appendImported(const TaskList& list, vector<task> imported) {
+    unordered_set<string> taken;
+    list.forEach([&taken](const task& t) { taken.insert(t.id); });
+    uint64_t nextId = list.maxNumericId();
+    for (const task& t : imported) {
+        uint64_t id = 0;
+        if (numericId(t.id, id)) nextId = max(nextId, id);
+        if (numericId(t.parent, id)) nextId = max(nextId, id);
+    }
+    ++nextId;
+
+    // parent в импорте ссылается на первую задачу импорта с этим id: если она
+    // сохранила id, ссылка остаётся, если получила новый номер - переписывается
+    unordered_set<string> kept;
+    unordered_map<string, string> renamed;
+    for (task& t : imported) {
+        if (!t.id.empty() && !taken.count(t.id) && kept.insert(t.id).second) continue;
+        string fresh = to_string(nextId++);
+        if (!t.id.empty() && !kept.count(t.id)) renamed.emplace(t.id, fresh);
+        t.id = std::move(fresh);
+    }
+    TaskList result = list;
+    for (task& t : imported) {
+        auto it = renamed.find(t.parent);
+        if (it != renamed.end()) t.parent = it->second;
+        result = result.pushBack(std::move(t));
+    }
+    return result;
+}
+
+// Потоковая запись задач в любом из форматов: задачи приходят по одной,
+// заранее их количество знать не нужно.
+class TaskStreamWriter {
+public:
+    TaskStreamWriter(ostream& out, TaskFormat format)
+        : out(out), format(format) {
+        if (format == TaskFormat::Json) out << "[\n";
+        else if (format == TaskFormat::Csv) out << kCsvHeader << '\n';
+    }
+
+    void write(const task& t) {
+        if (format == TaskFormat::Json) {
+            if (count > 0) out << ",\n";
+            writeTaskJsonObject(out, t);
+        }
+        else if (format == TaskFormat::Csv) {
+            writeTaskCsv(out, t);
+        }
+        else {
+            writeTaskNdjson(out, t);
+        }
+        ++count;
+    }
+
+    void finish() {
+        if (format == TaskFormat::Json) {
+            if (count > 0) out << "\n";
+            out << "]\n";
+        }
+        out.flush();
+    }
+
+    size_t written() const { return count; }
+
+private:
+    ostream& out;
+    TaskFormat format;
+    size_t count = 0;
+};
+
+bool exportTasks(const string& name, const TaskList& list) {
+    TaskFormat format;
+    if (!formatFromName(name, format)) {
+        cerr << "Неизвестный формат файла " << name << " (ожидается .json, .csv, .ndjson)" << endl;
+        return false;
+    }
+    ofstream file(name, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Не удалось открыть файл для записи!" << endl;
+        return false;
+    }
+    TaskStreamWriter writer(file, format);
+    list.forEach([&writer](const task& t) { writer.write(t); });
+    writer.finish();
+    return !file.fail();
+}
+
+// Конвертация файла в файл без загрузки задач в память:
+// todo convert tasks.csv tasks.ndjson
+int convertTasks(const string& from, const string& to) {
+    TaskFormat inFormat, outFormat;
+    if (!formatFromName(from, inFormat) || !formatFromName(to, outFormat)) {
+        cerr << "Неизвестный формат файла (ожидается .json, .csv, .ndjson)" << endl;
+        return 1;
+    }
+    ifstream in(from, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Не удалось открыть файл для чтения!" << endl;
+        return 1;
+    }
+    // открытие выходного файла обнулило бы ещё не прочитанный вход
+    error_code ec;
+    if (filesystem::equivalent(from, to, ec)) {
+        cerr << "Входной и выходной файлы совпадают" << endl;
+        return 1;
+    }
+    ofstream out(to, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Не удалось открыть файл для записи!" << endl;
+        return 1;
+    }
+    TaskStreamWriter writer(out, outFormat);
+    ImportStats stats = importTasks(in, inFormat, [&writer](task& t) { writer.write(t); });
+    writer.finish();
+    cout << "Записано задач: " << stats.imported << ", отклонено записей: " << stats.rejected << endl;
+    return out.fail() ? 1 : 0;
+}
+
+// ===== Архив выполненных задач =====
+
+// Выполненные задачи со сроком раньше заданной даты переносятся из data.json
+// в архив archive.dat: файл только дописывается, задачи лежат блоками,
+// каждый блок сжат отдельно. Формат блока:
+//
+//   "TTAB" | rawSize u32 | packedSize u32 | count u32 | checksum u32 |
+//   minDue[10] | maxDue[10] | groupCount u32 | groupsSize u32 | groups | packed[packedSize]
+//
+// (числа little-endian; groups - группы задач блока через '\n', groupCount = 0,
+// если групп больше kArchiveMaxGroups; checksum - FNV-1a несжатых данных;
+// несжатые данные - задачи в формате NDJSON).
+// Заголовки и есть индекс: поиск читает только их и распаковывает лишь блоки,
+// которые могут содержать нужную группу или даты.
+
+const char kArchiveMagic[4] = { 'T', 'T', 'A', 'B' };
+const size_t kArchiveBlockBytes = 64 * 1024;
+const size_t kArchiveMaxGroups = 32;
+// блок закрывается, как только превысит kArchiveBlockBytes, а строка задачи
+// не длиннее kMaxRecordBytes; больший rawSize в заголовке - признак порчи
+const size_t kArchiveMaxRawBytes = kArchiveBlockBytes + kMaxRecordBytes;
+
+// ---- сжатие (LZ77) ----
+//
+// Поток из групп: управляющий байт + 8 элементов. Бит 0 - литерал (1 байт),
+// бит 1 - повтор: смещение u16 (1..65535 назад) и длина-4 (u8), т.е. 4..259 байт.
+
+const size_t kLzMinMatch = 4;
+const size_t kLzMaxMatch = 255 + kLzMinMatch;
+const size_t kLzWindow = 65535;
+const unsigned kLzHashBits = 14;
+
+uint32_t lzHash(const unsigned char* p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    return (v * 2654435761u) >> (32 - kLzHashBits);
+}
+
+string lzCompress(const string& input) {
+    string out;
+    out.reserve(input.size() / 2 + 16);
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+    size_t n = input.size();
+    vector<size_t> table(size_t(1) << kLzHashBits, SIZE_MAX);
+
+    size_t pos = 0;
+    while (pos < n) {
+        size_t control = out.size();
+        out += '\0';
+        for (int bit = 0; bit < 8 && pos < n; ++bit) {
+            size_t bestLen = 0;
+            size_t bestOff = 0;
+            if (pos + kLzMinMatch <= n) {
+                uint32_t h = lzHash(data + pos);
+                size_t cand = table[h];
+                table[h] = pos;
+                if (cand != SIZE_MAX && pos - cand <= kLzWindow) {
+                    size_t limit = min(kLzMaxMatch, n - pos);
+                    size_t len = 0;
+                    while (len < limit && data[cand + len] == data[pos + len]) ++len;
+                    if (len >= kLzMinMatch) {
+                        bestLen = len;
+                        bestOff = pos - cand;
+                    }
+                }
+            }
+            if (bestLen) {
+                out[control] = static_cast<char>(out[control] | (1 << bit));
+                out += static_cast<char>(bestOff & 0xFF);
+                out += static_cast<char>(bestOff >> 8);
+                out += static_cast<char>(bestLen - kLzMinMatch);
+                // запоминаем позиции внутри повтора, чтобы находить следующие
+                for (size_t k = 1; k < bestLen && pos + k + kLzMinMatch <= n; ++k) {
+                    table[lzHash(data + pos + k)] = pos + k;
+                }
+                pos += bestLen;
+            }
+            else {
+                out += static_cast<char>(data[pos]);
+                ++pos;
+            }
+        }
+    }
+    return out;
+}
+
+// false, если сжатые данные повреждены
+bool lzDecompress(const string& input, size_t rawSize, string& out) {
+    out.clear();
+    out.reserve(rawSize);
+    size_t i = 0;
+    while (i < input.size()) {
+        unsigned char control = static_cast<unsigned char>(input[i++]);
+        for (int bit = 0; bit < 8 && i < input.size(); ++bit) {
+            if (control & (1 << bit)) {
+                if (i + 3 > input.size()) return false;
+                size_t off = static_cast<unsigned char>(input[i]) | (static_cast<unsigned char>(input[i + 1]) << 8);
+                size_t len = static_cast<unsigned char>(input[i + 2]) + kLzMinMatch;
+                i += 3;
+                if (off == 0 || off > out.size() || out.size() + len > rawSize) return false;
+                size_t from = out.size() - off;
+                for (size_t k = 0; k < len; ++k) out += out[from + k]; // повтор может перекрываться
+            }
+            else {
+                if (out.size() + 1 > rawSize) return false;
+                out += input[i++];
+            }
+        }
+    }
+    return out.size() == rawSize;
+}
+
+uint32_t fnv1a(const string& data) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// ---- блоки ----
+
+void putU32(string& out, uint32_t v) {
+    for (int k = 0; k < 4; ++k) out += static_cast<char>((v >> (8 * k)) & 0xFF);
+}
+
+bool getU32(istream& in, uint32_t& v) {
+    unsigned char b[4];
+    if (!in.read(reinterpret_cast<char*>(b), 4)) return false;
+    v = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    return true;
+}
+
+struct ArchiveBlock {
+    uint64_t payloadOffset = 0; // смещение сжатых данных в файле
+    uint32_t rawSize = 0;
+    uint32_t packedSize = 0;
+    uint32_t count = 0;
+    uint32_t checksum = 0;
+    string minDue;
+    string maxDue;
+    vector<string> groups; // пусто - в блоке слишком много групп, проверять все
+
+    bool mayContainGroup(const string& group) const {
+        return groups.empty() || find(groups.begin(), groups.end(), group) != groups.end();
+    }
+};
+
+// Индекс архива: заголовки всех целых блоков до первого повреждения,
+// tailOffset указывает на конец последнего целого блока.
+// Недописанный хвост (сбой во время записи) - это начало блока, обрывающееся
+// концом файла: он пропускается, corrupted остаётся false. Любой другой
+// нечитаемый заголовок - порча архива: corrupted = true, блоки за ним недоступны.
+bool readArchiveIndex(const string& name, vector<ArchiveBlock>& blocks, uint64_t& tailOffset, bool& corrupted) {
+    blocks.clear();
+    tailOffset = 0;
+    corrupted = false;
+    ifstream in(name, ios::binary);
+    if (!in.is_open()) return false;
+    in.seekg(0, ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    while (tailOffset < fileSize) {
+        char magic[4] = {};
+        ArchiveBlock b;
+        uint32_t groupCount = 0;
+        uint32_t groupsSize = 0;
+        char due[20];
+        in.read(magic, 4);
+        size_t got = static_cast<size_t>(in.gcount());
+        if (!equal(magic, magic + got, kArchiveMagic)) {
+            corrupted = true;
+            break;
+        }
+        if (got < 4 || !getU32(in, b.rawSize) || !getU32(in, b.packedSize)
+            || !getU32(in, b.count) || !getU32(in, b.checksum)
+            || !in.read(due, 20) || !getU32(in, groupCount) || !getU32(in, groupsSize)) {
+            break; // заголовок оборван концом файла
+        }
+        if (groupCount > kArchiveMaxGroups || groupsSize > kArchiveBlockBytes
+            || b.rawSize > kArchiveMaxRawBytes || b.packedSize > 2 * kArchiveMaxRawBytes) {
+            corrupted = true;
+            break;
+        }
+        string groups(groupsSize, '\0');
+        if (groupsSize && !in.read(&groups[0], groupsSize)) break;
+        b.minDue.assign(due, 10);
+        b.maxDue.assign(due + 10, 10);
+        b.payloadOffset = static_cast<uint64_t>(in.tellg());
+        if (b.payloadOffset + b.packedSize > fileSize) break;
+        size_t start = 0;
+        for (uint32_t k = 0; k < groupCount; ++k) {
+            size_t end = groups.find('\n', start);
+            if (end == string::npos) end = groups.size();
+            b.groups.push_back(groups.substr(start, end - start));
+            start = end + 1;
+        }
+        in.seekg(static_cast<streamoff>(b.payloadOffset + b.packedSize));
+        tailOffset = b.payloadOffset + b.packedSize;
+        blocks.push_back(std::move(b));
+    }
+    if (corrupted) {
+        cerr << "Архив " << name << " повреждён по смещению " << tailOffset
+            << ": следующие " << (fileSize - tailOffset) << " байт недоступны" << endl;
+    }
+    else if (tailOffset < fileSize) {
+        cerr << "Предупреждение: недописанный хвост архива " << name
+            << " (" << (fileSize - tailOffset) << " байт) пропущен" << endl;
+    }
+    return true;
+}
+
+bool readArchiveBlock(istream& in, const ArchiveBlock& b, vector<task>& tasks) {
+    string packed(b.packedSize, '\0');
+    in.clear();
+    in.seekg(static_cast<streamoff>(b.payloadOffset));
+    if (b.packedSize && !in.read(&packed[0], b.packedSize)) return false;
+    string raw;
+    if (!lzDecompress(packed, b.rawSize, raw) || fnv1a(raw) != b.checksum) return false;
+    // задачи уже были в списке: разбираются как есть, без проверок импорта
+    tasks.clear();
+    vector<pair<string, string>> fields;
+    string line, error;
+    size_t start = 0;
+    while (start < raw.size()) {
+        size_t end = raw.find('\n', start);
+        if (end == string::npos) end = raw.size();
+        line.assign(raw, start, end - start);
+        start = end + 1;
+        if (!parseJsonObjectLine(line, fields, error)) return false;
+        task t;
+        for (const auto& field : fields) {
+            if (!setTaskField(t, field.first, field.second, error)) return false;
+        }
+        tasks.push_back(std::move(t));
+    }
+    return true;
+}
+
+// Пишет блоки из tasks в конец архива. Перед дозаписью обрезает
+// недописанный хвост, чтобы новые блоки не оказались за мусором.
+// В повреждённый архив не пишет: обрезка уничтожила бы целые блоки за порчей.
+bool appendArchiveBlocks(const string& name, const vector<task>& tasks) {
+    ostringstream line;
+    for (const task& t : tasks) {
+        line.str("");
+        writeTaskNdjson(line, t);
+        if (line.tellp() > static_cast<streamoff>(kMaxRecordBytes)) {
+            cerr << "Задача №" << t.id << " длиннее " << kMaxRecordBytes
+                << " байт и не может быть записана в архив" << endl;
+            return false;
+        }
+    }
+    vector<ArchiveBlock> existing;
+    uint64_t tailOffset = 0;
+    bool corrupted = false;
+    if (readArchiveIndex(name, existing, tailOffset, corrupted)) {
+        if (corrupted) {
+            cerr << "Дозапись в повреждённый архив " << name << " отменена" << endl;
+            return false;
+        }
+        error_code ec;
+        if (filesystem::file_size(name, ec) != tailOffset && !ec) {
+            filesystem::resize_file(name, tailOffset, ec);
+            if (ec) {
+                cerr << "Не удалось обрезать архив " << name << ": " << ec.message() << endl;
+                return false;
+            }
+        }
+    }
+    ofstream out(name, ios::binary | ios::app);
+    if (!out.is_open()) {
+        cerr << "Не удалось открыть архив для записи!" << endl;
+        return false;
+    }
+
+    size_t i = 0;
+    while (i < tasks.size()) {
+        ostringstream raw;
+        string minDue = tasks[i].due, maxDue = tasks[i].due;
+        vector<string> groups;
+        bool groupsKnown = true;
+        size_t groupsSize = 0; // длина списка групп через '\n'
+        uint32_t count = 0;
+        while (i < tasks.size() && (count == 0 || raw.tellp() < static_cast<streamoff>(kArchiveBlockBytes))) {
+            const task& t = tasks[i++];
+            writeTaskNdjson(raw, t);
+            minDue = min(minDue, t.due);
+            maxDue = max(maxDue, t.due);
+            if (t.group.find('\n') != string::npos) {
+                groupsKnown = false; // не уложится в список через '\n'
+            }
+            else if (groupsKnown && find(groups.begin(), groups.end(), t.group) == groups.end()) {
+                groups.push_back(t.group);
+                groupsSize += t.group.size() + (groups.size() > 1 ? 1 : 0);
+                // те же границы, что проверяет readArchiveIndex
+                groupsKnown = groups.size() <= kArchiveMaxGroups && groupsSize <= kArchiveBlockBytes;
+            }
+            ++count;
+        }
+        if (!groupsKnown) groups.clear();
+        string joined;
+        for (size_t k = 0; k < groups.size(); ++k) {
+            if (k) joined += '\n';
+            joined += groups[k];
+        }
+
+        string body = raw.str();
+        string packed = lzCompress(body);
+        string header(kArchiveMagic, 4);
+        putU32(header, static_cast<uint32_t>(body.size()));
+        putU32(header, static_cast<uint32_t>(packed.size()));
+        putU32(header, count);
+        putU32(header, fnv1a(body));
+        header += minDue.substr(0, 10) + string(10 - min<size_t>(10, minDue.size()), ' ');
+        header += maxDue.substr(0, 10) + string(10 - min<size_t>(10, maxDue.size()), ' ');
+        putU32(header, static_cast<uint32_t>(groups.size()));
+        putU32(header, static_cast<uint32_t>(joined.size()));
+        header += joined;
+        out << header << packed;
+    }
+    out.flush();
+    return !out.fail();
+}
+
+// Переносит выполненные задачи со сроком раньше before в архив.
+// remaining - рабочий список без них. Возвращает число перенесённых задач
+// или -1, если архив записать не удалось (тогда список не меняется).
+long archiveCompleted(const TaskList& list, const string& before, const string& archiveName, TaskList& remaining) {
+    vector<task> keep, cold;
+    list.forEach([&](const task& t) {
+        // срок из файла может быть любым: некорректный не сравниваем
+        if (t.done && isValidDueDate(t.due) && isOverdue(t.due, before)) cold.push_back(t);
+        else keep.push_back(t);
+    });
+    if (cold.empty()) {
+        remaining = list;
+        return 0;
+    }
+    if (!appendArchiveBlocks(archiveName, cold)) {
+        remaining = list;
+        return -1;
+    }
+    remaining = TaskList::fromVector(std::move(keep));
+    return static_cast<long>(cold.size());
+}
+
+// Поиск в архиве: group пустая - любая группа; from/to - границы срока
+// включительно (пустые - без ограничения). Блоки отбираются по заголовкам.
+size_t queryArchive(const string& archiveName, const string& group, const string& from, const string& to,
+    const function<void(const task&)>& onTask) {
+    vector<ArchiveBlock> blocks;
+    uint64_t tailOffset = 0;
+    bool corrupted = false;
+    if (!readArchiveIndex(archiveName, blocks, tailOffset, corrupted)) {
+        cerr << "Архив " << archiveName << " не найден." << endl;
+        return 0;
+    }
+    ifstream in(archiveName, ios::binary);
+    size_t found = 0;
+    vector<task> tasks;
+    for (const ArchiveBlock& b : blocks) {
+        if (!group.empty() && !b.mayContainGroup(group)) continue;
+        if (!from.empty() && b.maxDue < from) continue;
+        if (!to.empty() && b.minDue > to) continue;
+        if (!readArchiveBlock(in, b, tasks)) {
+            cerr << "Блок архива по смещению " << b.payloadOffset << " повреждён, пропущен" << endl;
+            continue;
+        }
+        for (const task& t : tasks) {
+            if (!group.empty() && t.group != group) continue;
+            if (!from.empty() && t.due < from) continue;
+            if (!to.empty() && t.due > to) continue;
+            ++found;
+            onTask(t);
+        }
+    }
+    return found;
+}
+
+// Архивация без интерактивного меню (для периодического запуска):
+// todo archive 2025-12-01
+int archiveFile(const string& name, const string& archiveName, const string& before) {
+    if (!isValidDueDate(before)) {
+        cerr << "Некорректная дата: " << before << endl;
+        return 1;
+    }
+    vector<task> list;
+    readFile(name, list);
+    TaskList remaining;
+    long moved = archiveCompleted(TaskList::fromVector(std::move(list)), before, archiveName, remaining);
+    if (moved < 0) return 1;
+    if (moved > 0 && !saveAllTasksAtomic(name, remaining)) return 1;
+    cout << "Перенесено в архив задач: " << moved << endl;
+    return 0;
+}
+
+// ===== Режим наблюдения =====
+
+// Сохранённые представления (фильтр по группе и/или "просрочено на сегодня")
+// держат у себя текущий набор подходящих задач. При изменении data.json файл
+// перечитывается и сравнивается с предыдущим состоянием по id, а в каждое
+// представление применяются только изменившиеся задачи.
+
+string todayString() {
+    time_t now = time(nullptr);
+    tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char buf[11];
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+    return buf;
+}
+
+bool sameTask(const task& a, const task& b) {
+    return a.id == b.id && a.title == b.title && a.due == b.due
+        && a.priority == b.priority && a.group == b.group && a.done == b.done
+        && a.parent == b.parent;
+}
+
+struct TaskDelta {
+    vector<pair<string, task>> added;
+    vector<pair<string, task>> removed;
+    vector<pair<string, task>> changed; // новая версия задачи
+
+    bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+};
+
+// Сравнение нового содержимого файла с известным состоянием (ключ - id;
+// повторяющиеся id различаются номером вхождения). known обновляется.
+TaskDelta diffTasks(unordered_map<string, task>& known, vector<task>& fresh) {
+    TaskDelta delta;
+    unordered_map<string, size_t> seenIds;
+    unordered_set<string> present;
+    present.reserve(fresh.size());
+    for (task& t : fresh) {
+        size_t occurrence = seenIds[t.id]++;
+        string key = occurrence == 0 ? t.id : t.id + "#" + to_string(occurrence);
+        present.insert(key);
+        auto it = known.find(key);
+        if (it == known.end()) {
+            delta.added.emplace_back(key, t);
+            known.emplace(key, std::move(t));
+        }
+        else if (!sameTask(it->second, t)) {
+            delta.changed.emplace_back(key, t);
+            it->second = std::move(t);
+        }
+    }
+    for (auto it = known.begin(); it != known.end();) {
+        if (!present.count(it->first)) {
+            delta.removed.emplace_back(it->first, std::move(it->second));
+            it = known.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    return delta;
+}
+
+struct SavedView {
+    string name;
+    string group;             // пусто - любая группа
+    bool overdueOnly = false; // только невыполненные с истёкшим сроком
+    map<string, task> rows;   // задачи, попадающие в представление
+
+    bool matches(const task& t, const string& today) const {
+        if (!group.empty() && t.group != group) return false;
+        if (overdueOnly && (t.done || !isValidDueDate(t.due) || !isOverdue(t.due, today))) return false;
+        return true;
+    }
+
+    // полный пересчёт: при запуске и при смене даты
+    void rebuild(const unordered_map<string, task>& known, const string& today) {
+        rows.clear();
+        for (const auto& kv : known) {
+            if (matches(kv.second, today)) rows.emplace(kv.first, kv.second);
+        }
+    }
+};
+
+void PrintViewLine(char mark, const task& elem) {
+    cout << "  " << mark << " Задача №" << elem.id
+        << " | " << elem.priority
+        << " | " << elem.title
+        << " | до " << elem.due
+        << " | " << (elem.done ? "Выполнена" : "Не выполнена")
+        << " | " << elem.group << endl;
+}
+
+void PrintView(const SavedView& view) {
+    cout << "=== " << view.name << " (задач: " << view.rows.size() << ") ===" << endl;
+    for (const auto& kv : view.rows) {
+        PrintViewLine(' ', kv.second);
+    }
+}
+
+// применяет изменения к представлению и печатает только их
+void ApplyDelta(SavedView& view, const TaskDelta& delta, const string& today) {
+    vector<pair<char, task>> lines;
+    for (const auto& kv : delta.removed) {
+        if (view.rows.erase(kv.first)) lines.emplace_back('-', kv.second);
+    }
+    for (const auto& kv : delta.added) {
+        if (view.matches(kv.second, today)) {
+            view.rows[kv.first] = kv.second;
+            lines.emplace_back('+', kv.second);
+        }
+    }
+    for (const auto& kv : delta.changed) {
+        auto it = view.rows.find(kv.first);
+        bool now = view.matches(kv.second, today);
+        if (it != view.rows.end() && now) {
+            it->second = kv.second;
+            lines.emplace_back('~', kv.second);
+        }
+        else if (it != view.rows.end()) {
+            view.rows.erase(it);
+            lines.emplace_back('-', kv.second);
+        }
+        else if (now) {
+            view.rows.emplace(kv.first, kv.second);
+            lines.emplace_back('+', kv.second);
+        }
+    }
+    if (lines.empty()) return;
+    cout << "=== " << view.name << " (задач: " << view.rows.size() << ") ===" << endl;
+    for (const auto& line : lines) {
+        PrintViewLine(line.first, line.second);
+    }
+}
+
+// представления хранятся в текстовом файле: имя<TAB>группа<TAB>0|1
+vector<SavedView> loadViews(const string& name) {
+    vector<SavedView> views;
+    ifstream file(name);
+    string line;
+    while (getline(file, line)) {
+        size_t a = line.find('\t');
+        size_t b = a == string::npos ? string::npos : line.find('\t', a + 1);
+        if (b == string::npos) continue;
+        SavedView view;
+        view.name = line.substr(0, a);
+        view.group = line.substr(a + 1, b - a - 1);
+        view.overdueOnly = line.substr(b + 1) == "1";
+        views.push_back(std::move(view));
+    }
+    return views;
+}
+
+void saveViews(const string& name, const vector<SavedView>& views) {
+    ofstream file(name);
+    if (!file.is_open()) {
+        cerr << "Не удалось сохранить представления в " << name << endl;
+        return;
+    }
+    for (const auto& view : views) {
+        file << view.name << '\t' << view.group << '\t' << (view.overdueOnly ? "1" : "0") << '\n';
+    }
+}
+
+// Ожидание изменений файла: inotify на Linux (следим за каталогом, т.к. файл
+// заменяется переименованием), на остальных системах - опрос времени изменения.
+class FileWatcher {
+public:
+    explicit FileWatcher(const string& path)
+        : path(path) {
+        rememberStamp();
+#ifdef __linux__
+        filesystem::path p = filesystem::absolute(path);
+        fileName = p.filename().string();
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, p.parent_path().string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(fd);
+            fd = -1;
+        }
+#endif
+    }
+
+    ~FileWatcher() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // true, если файл изменился; ждёт не дольше timeoutMs
+    bool wait(int timeoutMs) {
+#ifdef __linux__
+        if (fd >= 0) {
+            pollfd pfd{ fd, POLLIN, 0 };
+            if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+            bool touched = false;
+            alignas(inotify_event) char buf[4096];
+            ssize_t len;
+            while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* ptr = buf; ptr < buf + len;) {
+                    const inotify_event* ev = reinterpret_cast<const inotify_event*>(ptr);
+                    if (ev->len && fileName == ev->name) touched = true;
+                    ptr += sizeof(inotify_event) + ev->len;
+                }
+            }
+            return touched;
+        }
+#endif
+        this_thread::sleep_for(chrono::milliseconds(timeoutMs));
+        return rememberStamp();
+    }
+
+private:
+    // true, если время изменения или размер файла поменялись
+    bool rememberStamp() {
+        error_code ec;
+        auto time = filesystem::last_write_time(path, ec);
+        uintmax_t size = ec ? 0 : filesystem::file_size(path, ec);
+        bool changed = time != lastWrite || size != lastSize;
+        lastWrite = time;
+        lastSize = size;
+        return changed;
+    }
+
+    string path;
+    filesystem::file_time_type lastWrite{};
+    uintmax_t lastSize = 0;
+#ifdef __linux__
+    string fileName;
+    int fd = -1;
+#endif
+};
+
+// Наблюдение за файлом до нажатия Enter
+void WatchViews(const string& filename, vector<SavedView>& views) {
+    // наблюдение начинается до первого чтения: запись, попавшая между ними,
+    // не потеряется, а даст лишнее (пустое) сравнение
+    FileWatcher watcher(filename);
+    unordered_map<string, task> known;
+    vector<task> fresh;
+    readFile(filename, fresh);
+    diffTasks(known, fresh);
+
+    string today = todayString();
+    for (auto& view : views) {
+        view.rebuild(known, today);
+        PrintView(view);
+    }
+
+    cout << "Режим наблюдения за " << filename << ". Нажмите Enter для выхода." << endl;
+    atomic<bool> stop(false);
+    thread input([&stop]() {
+        string line;
+        getline(cin, line);
+        stop = true;
+    });
+
+    while (!stop) {
+        bool changed = watcher.wait(500);
+
+        string now = todayString();
+        if (now != today) {
+            // с новой датой просроченными становятся другие задачи
+            today = now;
+            cout << "Новая дата: " << today << endl;
+            for (auto& view : views) {
+                view.rebuild(known, today);
+                PrintView(view);
+            }
+        }
+        if (!changed) continue;
+
+        // серия записей подряд - одно обновление
+        this_thread::sleep_for(chrono::milliseconds(100));
+        while (watcher.wait(0)) {}
+
+        fresh.clear();
+        readFile(filename, fresh);
+        TaskDelta delta = diffTasks(known, fresh);
+        if (delta.empty()) continue;
+        cout << "Изменения: добавлено " << delta.added.size()
+            << ", изменено " << delta.changed.size()
+            << ", удалено " << delta.removed.size() << endl;
+        for (auto& view : views) {
+            ApplyDelta(view, delta, today);
+        }
+    }
+    input.join();
+}
+
+// ===== Слияние нескольких файлов задач =====
+
+// todo merge out.json team1.json team2.csv ...
+//
+// 1. Каждый входной файл читается один раз и режется на отсортированные по
+//    (group, due) серии во временных файлах. Пока вход уже упорядочен,
+//    задачи пишутся в серию сразу; после первого нарушения порядка остаток
+//    файла сортируется в памяти кусками по kMergeRunTasks задач. Входы
+//    обрабатываются параллельно, по одному на поток.
+// 2. Серии сливаются через кучу (k-way merge) и пишутся в выходной файл за
+//    один проход. Одинаковые по содержимому задачи (все поля, кроме id) имеют
+//    одинаковый ключ и идут подряд, поэтому дубликаты ищутся только среди
+//    задач с текущим ключом.
+// 3. Занятый id получает новый номер больше максимального числового id
+//    среди всех входов (он известен после шага 1). Выданные числовые id до
+//    kMergeBitmapIds отмечаются в битовой карте (не больше 16 МБ), остальные
+//    (нечисловые вроде UUID и очень большие) хранятся в usedOtherIds до конца
+//    слияния: для таких входов память растёт с числом задач, примерно на
+//    длину id плюс 50 байт на каждую.
+// 4. Поле parent ссылается на id своего входа. Если во входах есть подзадачи,
+//    результат шага 2 сначала пишется во временную серию, а для каждого входа
+//    запоминается, какие его id заменены (новым номером или id оставленного
+//    дубликата); при копировании серии в выходной файл parent переписывается
+//    по этой таблице. Подзадачи из разных входов дубликатами не считаются:
+//    одинаковый parent в них может означать разные задачи.
+
+const size_t kMergeRunTasks = 250000; // на каждый поток нарезки
+const uint64_t kMergeBitmapIds = uint64_t(1) << 27;
+
+// сравнение ключей слияния (group, due): <0, 0 или >0
+int mergeKeyCompare(const task& a, const task& b) {
+    int c = a.group.compare(b.group);
+    return c != 0 ? c : a.due.compare(b.due);
+}
+
+bool mergeKeyLess(const task& a, const task& b) {
+    return mergeKeyCompare(a, b) < 0;
+}
+
+bool sameContent(const task& a, const task& b) {
+    return a.title == b.title && a.due == b.due && a.priority == b.priority
+        && a.group == b.group && a.done == b.done && a.parent == b.parent;
+}
+
+uint64_t contentHash(const task& t) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const string& s) {
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= 0xFF; // разделитель полей
+        h *= 1099511628211ull;
+    };
+    mix(t.title);
+    mix(t.due);
+    mix(t.priority);
+    mix(t.group);
+    mix(t.parent);
+    h ^= t.done ? 1 : 2;
+    return h * 1099511628211ull;
+}
+
+// Серии - внутренний формат слияния: каждое строковое поле с длиной u32,
+// затем байт done. Читается без разбора JSON и экранирования.
+// Записи копятся в буфере и уходят в файл кусками по ~64 КБ.
+class RunWriter {
+public:
+    explicit RunWriter(const string& name)
+        : out(name, ios::binary) {}
+
+    void write(const task& t) {
+        for (const string* field : { &t.id, &t.title, &t.due, &t.priority, &t.group, &t.parent }) {
+            putU32(buffer, static_cast<uint32_t>(field->size()));
+            buffer += *field;
+        }
+        buffer += t.done ? '\1' : '\0';
+        if (buffer.size() >= (1 << 16)) flush();
+    }
+
+    // false при ошибке записи
+    bool close() {
+        flush();
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    void flush() {
+        out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+    ofstream out;
+    string buffer;
+};
+
+bool readRunTask(istream& in, task& t) {
+    for (string* field : { &t.id, &t.title, &t.due, &t.priority, &t.group, &t.parent }) {
+        uint32_t size = 0;
+        if (!getU32(in, size)) return false;
+        field->resize(size);
+        if (size && !in.read(&(*field)[0], size)) return false;
+    }
+    char done = 0;
+    if (!in.get(done)) return false;
+    t.done = done != 0;
+    return true;
+}
+
+class RunReader {
+public:
+    explicit RunReader(const string& name)
+        : in(name, ios::binary) {}
+
+    bool next(task& t) { return readRunTask(in, t); }
+
+private:
+    ifstream in;
+};
+
+struct MergeStats {
+    size_t read = 0;
+    size_t rejected = 0;
+    size_t written = 0;
+    size_t duplicates = 0;
+    size_t remapped = 0;
+    size_t subtasks = 0;
+};
+
+// Шаг 1: нарезка входа на отсортированные серии (имена серий начинаются с prefix).
+// Возвращает false при ошибке ввода-вывода.
+bool splitIntoRuns(const string& input, const filesystem::path& tmpDir, const string& prefix,
+    vector<string>& runs, uint64_t& maxId, MergeStats& stats) {
+    TaskFormat format;
+    if (!formatFromName(input, format)) {
+        cerr << "Неизвестный формат файла " << input << " (ожидается .json, .csv, .ndjson)" << endl;
+        return false;
+    }
+    ifstream in(input, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Не удалось открыть файл " << input << endl;
+        return false;
+    }
+
+    auto newRun = [&]() {
+        runs.push_back((tmpDir / (prefix + to_string(runs.size()) + ".bin")).string());
+        return make_unique<RunWriter>(runs.back());
+    };
+
+    unique_ptr<RunWriter> direct = newRun(); // серия для уже упорядоченного начала файла
+    bool ordered = true;
+    bool ok = true;
+    task last;
+    size_t directCount = 0;
+    vector<task> buffer;
+
+    // сортируются компактные копии ключей с номером задачи, а не сами задачи:
+    // меньше перемещений строк и обращений вразброс по буферу
+    struct SortKey {
+        string group;
+        string due;
+        uint32_t index;
+    };
+    vector<SortKey> order;
+    auto flushBuffer = [&]() {
+        if (buffer.empty()) return;
+        order.clear();
+        order.reserve(buffer.size());
+        for (size_t k = 0; k < buffer.size(); ++k) {
+            order.push_back({ buffer[k].group, buffer[k].due, static_cast<uint32_t>(k) });
+        }
+        sort(order.begin(), order.end(), [](const SortKey& a, const SortKey& b) {
+            int c = a.group.compare(b.group);
+            if (c == 0) c = a.due.compare(b.due);
+            return c != 0 ? c < 0 : a.index < b.index;
+        });
+        unique_ptr<RunWriter> run = newRun();
+        for (const SortKey& key : order) run->write(buffer[key.index]);
+        ok = run->close() && ok;
+        buffer.clear();
+    };
+
+    ImportStats imported = importTasks(in, format, [&](task& t) {
+        uint64_t id = 0;
+        if (numericId(t.id, id)) maxId = max(maxId, id);
+        if (!t.parent.empty()) ++stats.subtasks;
+        if (ordered && (directCount == 0 || !mergeKeyLess(t, last))) {
+            direct->write(t);
+            last = t;
+            ++directCount;
+            return;
+        }
+        ordered = false;
+        buffer.push_back(std::move(t));
+        if (buffer.size() >= kMergeRunTasks) flushBuffer();
+    }, input);
+    ok = direct->close() && ok;
+    flushBuffer();
+
+    stats.read += imported.imported;
+    stats.rejected += imported.rejected;
+    return ok;
+}
+
+// временные серии удаляются при любом выходе из слияния
+struct TempDirGuard {
+    filesystem::path dir;
+    ~TempDirGuard() {
+        error_code ignored;
+        filesystem::remove_all(dir, ignored);
+    }
+};
+
+int mergeTaskFiles(const string& output, const vector<string>& inputs) {
+    TaskFormat outFormat;
+    if (!formatFromName(output, outFormat)) {
+        cerr << "Неизвестный формат файла " << output << " (ожидается .json, .csv, .ndjson)" << endl;
+        return 1;
+    }
+
+    error_code ec;
+    filesystem::path tmpDir = filesystem::temp_directory_path(ec)
+        / ("todo-merge-" + to_string(random_device{}()));
+    if (ec || !filesystem::create_directories(tmpDir, ec)) {
+        cerr << "Не удалось создать временный каталог для слияния" << endl;
+        return 1;
+    }
+    TempDirGuard cleanup{ tmpDir };
+
+    // входы независимы, поэтому режутся на серии параллельно
+    vector<vector<string>> inputRuns(inputs.size());
+    vector<MergeStats> inputStats(inputs.size());
+    vector<uint64_t> inputMaxId(inputs.size(), 0);
+    atomic<size_t> nextInput(0);
+    atomic<bool> failed(false);
+    size_t workers = min<size_t>(inputs.size(), max(1u, thread::hardware_concurrency()));
+    vector<thread> pool;
+    for (size_t w = 0; w < workers; ++w) {
+        pool.emplace_back([&]() {
+            size_t k;
+            while (!failed && (k = nextInput++) < inputs.size()) {
+                if (!splitIntoRuns(inputs[k], tmpDir, "in" + to_string(k) + "-run",
+                        inputRuns[k], inputMaxId[k], inputStats[k])) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (thread& th : pool) th.join();
+    if (failed) return 1;
+
+    MergeStats stats;
+    vector<string> runs; // в порядке входов: при равных ключах раньше идёт более ранний вход
+    vector<size_t> runInput; // номер входа каждой серии
+    uint64_t maxId = 0;
+    for (size_t k = 0; k < inputs.size(); ++k) {
+        runs.insert(runs.end(), inputRuns[k].begin(), inputRuns[k].end());
+        runInput.insert(runInput.end(), inputRuns[k].size(), k);
+        maxId = max(maxId, inputMaxId[k]);
+        stats.read += inputStats[k].read;
+        stats.rejected += inputStats[k].rejected;
+        stats.subtasks += inputStats[k].subtasks;
+    }
+
+    ofstream out(output, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Не удалось открыть файл для записи!" << endl;
+        return 1;
+    }
+    TaskStreamWriter writer(out, outFormat);
+
+    // куча по (group, due, номер серии): при равных ключах порядок входов сохраняется
+    vector<unique_ptr<RunReader>> readers;
+    vector<task> heads(runs.size());
+    auto later = [&heads](size_t a, size_t b) {
+        int c = mergeKeyCompare(heads[a], heads[b]);
+        return c != 0 ? c > 0 : a > b;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        readers.push_back(make_unique<RunReader>(runs[r]));
+        if (readers[r]->next(heads[r])) heap.push(r);
+    }
+
+    vector<bool> usedIds(static_cast<size_t>(min(maxId + 1, kMergeBitmapIds)), false);
+    unordered_set<string> usedOtherIds; // нечисловые и очень большие id
+    uint64_t nextId = maxId + 1;
+    struct Written {
+        size_t input;
+        task value;
+    };
+    unordered_multimap<uint64_t, Written> sameKey; // уже записанные задачи с текущим ключом
+    task currentKey;
+
+    // шаг 4: заменённые id каждого входа (старый -> новый) и входы подзадач по порядку записи
+    unique_ptr<RunWriter> pending;
+    string pendingName = (tmpDir / "merged.bin").string();
+    if (stats.subtasks > 0) pending = make_unique<RunWriter>(pendingName);
+    vector<unordered_map<string, string>> renamed(inputs.size());
+    vector<uint32_t> parentInputs;
+
+    while (!heap.empty()) {
+        size_t r = heap.top();
+        heap.pop();
+        size_t input = runInput[r];
+        task t = std::move(heads[r]);
+        if (readers[r]->next(heads[r])) heap.push(r);
+
+        if (mergeKeyCompare(currentKey, t) != 0 || stats.written == 0) {
+            sameKey.clear();
+            currentKey.group = t.group;
+            currentKey.due = t.due;
+        }
+        uint64_t h = contentHash(t);
+        auto range = sameKey.equal_range(h);
+        const task* kept = nullptr;
+        for (auto it = range.first; it != range.second && !kept; ++it) {
+            if (sameContent(it->second.value, t) && (t.parent.empty() || it->second.input == input)) {
+                kept = &it->second.value;
+            }
+        }
+        if (kept) {
+            if (kept->id != t.id) renamed[input].emplace(t.id, kept->id);
+            ++stats.duplicates;
+            continue;
+        }
+
+        uint64_t id = 0;
+        bool taken;
+        if (numericId(t.id, id) && id < usedIds.size()) {
+            taken = usedIds[id];
+            usedIds[id] = true;
+        }
+        else {
+            taken = t.id.empty() || !usedOtherIds.insert(t.id).second;
+        }
+        if (taken) {
+            string fresh = to_string(nextId++);
+            renamed[input].emplace(t.id, fresh);
+            t.id = std::move(fresh);
+            ++stats.remapped;
+        }
+
+        if (pending) {
+            pending->write(t);
+            if (!t.parent.empty()) parentInputs.push_back(static_cast<uint32_t>(input));
+        }
+        else {
+            writer.write(t);
+        }
+        ++stats.written;
+        sameKey.emplace(h, Written{ input, std::move(t) });
     }
 
-    if (!anyTask) {
-        cerr << "Предупреждение: файл JSON прочитан, но задач не найдено." << endl;
+    if (pending) {
+        if (!pending->close()) {
+            cerr << "Не удалось записать временную серию слияния" << endl;
+            return 1;
+        }
+        RunReader merged(pendingName);
+        task t;
+        size_t subtask = 0;
+        while (merged.next(t)) {
+            if (!t.parent.empty()) {
+                const auto& names = renamed[parentInputs[subtask++]];
+                auto it = names.find(t.parent);
+                if (it != names.end()) t.parent = it->second;
+            }
+            writer.write(t);
+        }
     }
+    writer.finish();
 
-    file.close();
+    cout << "Прочитано задач: " << stats.read
+        << ", записано: " << stats.written
+        << ", дубликатов: " << stats.duplicates
+        << ", новых id: " << stats.remapped
+        << ", отклонено записей: " << stats.rejected << endl;
+    return out.fail() ? 1 : 0;
 }
 
-// Полная перезапись JSON-файла (используется после любых изменений)
-void saveAllTasks(const string& name, const vector<task>& list) {
-    ofstream file(name);
-    if (!file.is_open()) {
-        cerr << "Не удалось открыть файл для записи!" << endl;
-        return;
-    }
+// ===== Работа с задачами =====
 
-    file << "[\n";
-    for (size_t i = 0; i < list.size(); ++i) {
-        const task& t = list[i];
-        file << "    {\n";
-        file << "        \"id\": \"" << escapeJson(t.id) << "\",\n";
-        file << "        \"title\": \"" << escapeJson(t.title) << "\",\n";
-        file << "        \"due\": \"" << escapeJson(t.due) << "\",\n";
-        file << "        \"priority\": \"" << escapeJson(t.priority) << "\",\n";
-        file << "        \"group\": \"" << escapeJson(t.group) << "\",\n";
-        file << "        \"done\": " << (t.done ? "true" : "false") << "\n";
-        file << "    }";
-        if (i + 1 != list.size()) file << ",";
-        file << "\n";
-    }
-    file << "]\n";
-    file.close();
+// одна задача в общем формате вывода
+void PrintTaskLine(const task& elem) {
+    cout << "Задача №" << elem.id << endl;
+    cout << "Приоритет: " << elem.priority
+        << " | Название: " << elem.title
+        << " | Выполнить до: " << elem.due
+        << " | Статус: " << (elem.done ? "Выполнена" : "Не выполнена")
+        << " | Группа: " << elem.group;
+    if (!elem.parent.empty()) cout << " | Родитель: №" << elem.parent;
+    cout << endl;
 }
 
-// ===== Работа с задачами =====
-
-void PrintTask(const vector<task>& list) {
-    for (const auto& elem : list) {
-        cout << "Задача №" << elem.id << endl;
-        cout << "Приоритет: " << elem.priority
-            << " | Название: " << elem.title
-            << " | Выполнить до: " << elem.due
-            << " | Статус: " << (elem.done ? "Выполнена" : "Не выполнена")
-            << " | Группа: " << elem.group << endl;
-    }
+void PrintTask(const TaskList& list) {
+    list.forEach(PrintTaskLine);
 }
 
 // фильтр по группе
-void PrintByGroup(const vector<task>& list, const string& group) {
+void PrintByGroup(const TaskList& list, const string& group) {
     bool found = false;
-    for (const auto& elem : list) {
+    list.forEach([&](const task& elem) {
         if (elem.group == group) {
             found = true;
-            cout << "Задача №" << elem.id << endl;
-            cout << "Приоритет: " << elem.priority
-                << " | Название: " << elem.title
-                << " | Выполнить до: " << elem.due
-                << " | Статус: " << (elem.done ? "Выполнена" : "Не выполнена")
-                << " | Группа: " << elem.group << endl;
+            PrintTaskLine(elem);
         }
-    }
+    });
     if (!found) {
         cout << "Задач в группе \"" << group << "\" не найдено." << endl;
     }
 }
 
 // отчёт о просроченных задачах
-void PrintOverdue(const vector<task>& list, const string& today) {
+void PrintOverdue(const TaskList& list, const string& today) {
     bool found = false;
     int count = 0;
-    for (const auto& elem : list) {
-        if (!elem.done && isOverdue(elem.due, today)) {
+    list.forEach([&](const task& elem) {
+        if (!elem.done && isValidDueDate(elem.due) && isOverdue(elem.due, today)) {
             found = true;
             count++;
-            cout << "Задача №" << elem.id << endl;
-            cout << "Приоритет: " << elem.priority
-                << " | Название: " << elem.title
-                << " | Выполнить до: " << elem.due
-                << " | Статус: " << (elem.done ? "Выполнена" : "Не выполнена")
-                << " | Группа: " << elem.group << endl;
+            PrintTaskLine(elem);
         }
-    }
+    });
     if (!found) {
         cout << "Просроченных невыполненных задач нет." << endl;
     }
@@ -297,6 +2428,542 @@ void PrintOverdue(const vector<task>& list, const string& today) {
     }
 }
 
+// ===== Фоновые индексы =====
+
+// Меню доступно сразу после загрузки задач, а индексы (по группе, по сроку
+// невыполненных задач и по словам названия) строятся в фоновых потоках.
+// Индекс относится к конкретной версии списка: пока для читаемой версии
+// индекс не готов (идёт построение или список только что изменился),
+// запрос выполняется полным просмотром.
+
+// ключ даты YYYYMMDD для сравнения числами; 0 для некорректной даты
+uint32_t dateKey(const string& due) {
+    if (!isValidDueDate(due)) return 0;
+    uint32_t key = 0;
+    for (char c : due) {
+        if (c != '-') key = key * 10 + (c - '0');
+    }
+    return key;
+}
+
+// слова названия: разделители - ASCII-символы кроме букв и цифр,
+// латиница и кириллица (А-Я, Ё в UTF-8) приводятся к нижнему регистру,
+// остальные байты UTF-8 остаются как есть
+vector<string> splitWords(const string& title) {
+    vector<string> words;
+    string word;
+    for (size_t i = 0; i < title.size(); ++i) {
+        unsigned char u = static_cast<unsigned char>(title[i]);
+        unsigned char next = i + 1 < title.size() ? static_cast<unsigned char>(title[i + 1]) : 0;
+        if (u == 0xD0 && next >= 0x90 && next <= 0x9F) { // А-П -> а-п
+            word += '\xD0';
+            word += static_cast<char>(next + 0x20);
+            ++i;
+        }
+        else if (u == 0xD0 && next >= 0xA0 && next <= 0xAF) { // Р-Я -> р-я
+            word += '\xD1';
+            word += static_cast<char>(next - 0x20);
+            ++i;
+        }
+        else if (u == 0xD0 && next == 0x81) { // Ё -> ё
+            word += "\xD1\x91";
+            ++i;
+        }
+        else if (u >= 0x80 || isalnum(u)) {
+            word += u < 0x80 ? static_cast<char>(tolower(u)) : title[i];
+        }
+        else if (!word.empty()) {
+            words.push_back(std::move(word));
+            word.clear();
+        }
+    }
+    if (!word.empty()) words.push_back(std::move(word));
+    return words;
+}
+
+struct GroupIndex {
+    unordered_map<string, vector<uint32_t>> positions; // группа -> позиции по возрастанию
+};
+
+struct DueIndex {
+    vector<pair<uint32_t, uint32_t>> open; // (dateKey, позиция) невыполненных, по возрастанию срока
+};
+
+struct SearchIndex {
+    unordered_map<string, vector<uint32_t>> positions; // слово -> позиции по возрастанию
+};
+
+// построители получают флаг отмены: если версия уже устарела, обход
+// прерывается, а недостроенный индекс не публикуется
+
+GroupIndex buildGroupIndex(const TaskList& list, const atomic<bool>& cancel) {
+    GroupIndex index;
+    uint32_t pos = 0;
+    list.forEachWhile([&](const task& t) {
+        index.positions[t.group].push_back(pos++);
+        return !cancel;
+    });
+    return index;
+}
+
+DueIndex buildDueIndex(const TaskList& list, const atomic<bool>& cancel) {
+    DueIndex index;
+    uint32_t pos = 0;
+    list.forEachWhile([&](const task& t) {
+        uint32_t key = t.done ? 0 : dateKey(t.due);
+        if (key) index.open.emplace_back(key, pos);
+        ++pos;
+        return !cancel;
+    });
+    if (!cancel) sort(index.open.begin(), index.open.end());
+    return index;
+}
+
+SearchIndex buildSearchIndex(const TaskList& list, const atomic<bool>& cancel) {
+    SearchIndex index;
+    uint32_t pos = 0;
+    list.forEachWhile([&](const task& t) {
+        for (const string& word : splitWords(t.title)) {
+            vector<uint32_t>& hits = index.positions[word];
+            if (hits.empty() || hits.back() != pos) hits.push_back(pos); // слово дважды в названии
+        }
+        ++pos;
+        return !cancel;
+    });
+    return index;
+}
+
+// Фоновый поток, строящий один индекс. Как и в AsyncSaver, запросы
+// схлопываются: если за время построения пришло несколько версий,
+// следующей строится только последняя, а текущее построение прерывается.
+template <class Index>
+class BackgroundIndex {
+public:
+    explicit BackgroundIndex(function<Index(const TaskList&, const atomic<bool>&)> build)
+        : build(std::move(build)), worker(&BackgroundIndex::run, this) {}
+
+    ~BackgroundIndex() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+            cancel = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    BackgroundIndex(const BackgroundIndex&) = delete;
+    BackgroundIndex& operator=(const BackgroundIndex&) = delete;
+
+    // построить индекс для новой версии списка
+    void request(const TaskList& version) {
+        {
+            lock_guard<mutex> lock(m);
+            pending = version;
+            hasPending = true;
+            cancel = true;
+        }
+        cv.notify_all();
+    }
+
+    // индекс именно для этой версии или nullptr, если его ещё нет
+    shared_ptr<const Index> get(const TaskList& version) const {
+        lock_guard<mutex> lock(m);
+        if (built && builtFor.sameVersion(version)) return built;
+        return nullptr;
+    }
+
+private:
+    void run() {
+        unique_lock<mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [this] { return hasPending || stopping; });
+            if (stopping) return;
+            TaskList version = std::move(pending);
+            pending = TaskList();
+            hasPending = false;
+            cancel = false;
+            lock.unlock();
+
+            auto index = make_shared<const Index>(build(version, cancel));
+
+            lock.lock();
+            if (!cancel) {
+                built = std::move(index);
+                builtFor = std::move(version);
+            }
+        }
+    }
+
+    function<Index(const TaskList&, const atomic<bool>&)> build;
+    mutable mutex m;
+    condition_variable cv;
+    TaskList pending;
+    bool hasPending = false;
+    bool stopping = false;
+    atomic<bool> cancel{ false };
+    TaskList builtFor;
+    shared_ptr<const Index> built;
+    thread worker; // объявлен последним: стартует после инициализации остальных полей
+};
+
+struct TaskIndexes {
+    BackgroundIndex<GroupIndex> group{ buildGroupIndex };
+    BackgroundIndex<DueIndex> due{ buildDueIndex };
+    BackgroundIndex<SearchIndex> search{ buildSearchIndex };
+
+    void request(const TaskList& version) {
+        group.request(version);
+        due.request(version);
+        search.request(version);
+    }
+};
+
+void PrintTasksAt(const TaskList& list, const vector<uint32_t>& positions) {
+    for (uint32_t pos : positions) {
+        PrintTaskLine(list[pos]);
+    }
+}
+
+// поиск по слову названия полным просмотром
+void PrintByWord(const TaskList& list, const string& word) {
+    vector<uint32_t> positions;
+    uint32_t pos = 0;
+    list.forEach([&](const task& t) {
+        vector<string> words = splitWords(t.title);
+        if (find(words.begin(), words.end(), word) != words.end()) positions.push_back(pos);
+        ++pos;
+    });
+    if (positions.empty()) {
+        cout << "Задач со словом \"" << word << "\" не найдено." << endl;
+        return;
+    }
+    PrintTasksAt(list, positions);
+}
+
+// ниже - те же отчёты, что PrintByGroup/PrintOverdue/PrintByWord, но через индекс, если он готов
+
+void QueryByGroup(const TaskList& list, const string& group, const TaskIndexes& indexes) {
+    auto index = indexes.group.get(list);
+    if (!index) {
+        PrintByGroup(list, group);
+        return;
+    }
+    auto it = index->positions.find(group);
+    if (it == index->positions.end()) {
+        cout << "Задач в группе \"" << group << "\" не найдено." << endl;
+        return;
+    }
+    PrintTasksAt(list, it->second);
+}
+
+void QueryOverdue(const TaskList& list, const string& today, const TaskIndexes& indexes) {
+    auto index = indexes.due.get(list);
+    if (!index) {
+        PrintOverdue(list, today);
+        return;
+    }
+    uint32_t todayKey = dateKey(today);
+    vector<uint32_t> positions;
+    if (todayKey) {
+        for (const auto& entry : index->open) {
+            if (entry.first >= todayKey) break; // дальше сроки не раньше today
+            positions.push_back(entry.second);
+        }
+    }
+    if (positions.empty()) {
+        cout << "Просроченных невыполненных задач нет." << endl;
+        return;
+    }
+    sort(positions.begin(), positions.end()); // в порядке списка, как при просмотре
+    PrintTasksAt(list, positions);
+    cout << "Всего просроченных задач: " << positions.size() << endl;
+}
+
+void QueryByWord(const TaskList& list, const string& query, const TaskIndexes& indexes) {
+    vector<string> words = splitWords(query);
+    if (words.size() != 1) {
+        cout << "Введите одно слово." << endl;
+        return;
+    }
+    auto index = indexes.search.get(list);
+    if (!index) {
+        PrintByWord(list, words[0]);
+        return;
+    }
+    auto it = index->positions.find(words[0]);
+    if (it == index->positions.end()) {
+        cout << "Задач со словом \"" << words[0] << "\" не найдено." << endl;
+        return;
+    }
+    PrintTasksAt(list, it->second);
+}
+
+// ===== Подзадачи =====
+
+// Дерево подзадач: у задачи может быть родитель (поле parent - его id).
+// Узел заводится на каждый id, встречающийся как id задачи или как parent,
+// и хранит сводку по своему поддереву: число открытых и выполненных задач
+// и ближайший срок среди открытых. При изменении задачи сводки пересчитываются
+// только вдоль пути к корню, поэтому прогресс проекта и ближайший срок
+// в поддереве читаются за O(1), а правка стоит O(глубина * log(детей)).
+class TaskTree {
+public:
+    struct Rollup {
+        size_t open = 0;
+        size_t done = 0;
+        string earliestDue; // пусто - среди открытых нет задач со сроком
+    };
+
+    // сводка по поддереву id (вместе с самой задачей); nullptr, если id не встречался
+    const Rollup* rollup(const string& id) const {
+        auto it = nodes.find(id);
+        return it == nodes.end() ? nullptr : &it->second.rollup;
+    }
+
+    bool hasTask(const string& id) const { return taskCount(id) > 0; }
+
+    // задач с этим id; больше одной - id неоднозначен (файлы из старых версий,
+    // где id повторялись после удалений), ссылаться на него нельзя
+    size_t taskCount(const string& id) const {
+        auto it = nodes.find(id);
+        return it == nodes.end() ? 0 : it->second.tasks;
+    }
+
+    // можно ли сделать parent родителем id: оба id однозначны,
+    // родитель существует и не лежит в поддереве id
+    bool canAttach(const string& id, const string& parent) const {
+        if (taskCount(parent) != 1 || taskCount(id) > 1) return false;
+        auto self = nodes.find(id);
+        if (self == nodes.end()) return true;
+        for (const Node* cur = &nodes.at(parent); cur; cur = cur->up) {
+            if (cur == &self->second) return false;
+        }
+        return true;
+    }
+
+    void add(const task& t) {
+        Node& node = nodes[t.id];
+        // у повторяющихся id родитель берётся от первой задачи
+        if (node.tasks++ == 0) attach(node, t.parent);
+        propagate(&node, t.done ? 0 : 1, t.done ? 1 : 0, string(), openDue(t));
+    }
+
+    void remove(const task& t) {
+        auto it = nodes.find(t.id);
+        if (it == nodes.end() || it->second.tasks == 0) return;
+        Node& node = it->second;
+        propagate(&node, t.done ? 0 : -1, t.done ? -1 : 0, openDue(t), string());
+        if (--node.tasks == 0) {
+            // подзадачи удалённой задачи остаются под её id, сам узел отцепляется
+            detach(node);
+            prune(t.id);
+        }
+    }
+
+    // дерево соответствует именно этой версии списка
+    bool builtFor(const TaskList& list) const { return version.sameVersion(list); }
+
+    // Построение за один проход по списку и один проход снизу вверх:
+    // узел отдаёт сводку родителю, когда готовы сводки всех его детей.
+    void rebuild(const TaskList& list) {
+        nodes.clear();
+        nodes.reserve(list.size());
+        version = list;
+        list.forEach([this](const task& t) {
+            Node& node = nodes[t.id];
+            if (node.tasks++ == 0 && t.parent != t.id && !t.parent.empty()) {
+                node.parent = t.parent;
+                nodes[t.parent]; // родителя может не быть среди задач
+            }
+            if (t.done) ++node.rollup.done;
+            else ++node.rollup.open;
+            string due = openDue(t);
+            if (!due.empty()) node.dues.insert(std::move(due));
+        });
+        vector<Node*> ready;
+        for (auto& entry : nodes) {
+            Node& node = entry.second;
+            if (!node.parent.empty()) {
+                node.up = &nodes.at(node.parent);
+                ++node.up->children;
+            }
+        }
+        for (auto& entry : nodes) {
+            if (entry.second.children == 0) ready.push_back(&entry.second);
+        }
+        // пока сводки собираются, children служит счётчиком неготовых детей
+        vector<Node*> attached;
+        size_t finished = 0;
+        while (!ready.empty()) {
+            Node* node = ready.back();
+            ready.pop_back();
+            ++finished;
+            if (!node->dues.empty()) node->rollup.earliestDue = *node->dues.begin();
+            Node* up = node->up;
+            if (!up) continue;
+            attached.push_back(node);
+            up->rollup.open += node->rollup.open;
+            up->rollup.done += node->rollup.done;
+            if (!node->rollup.earliestDue.empty()) up->dues.insert(node->rollup.earliestDue);
+            if (--up->children == 0) ready.push_back(up);
+        }
+        for (Node* node : attached) ++node->up->children;
+        if (finished != nodes.size()) {
+            // в данных есть цикл родителей: собираем по одной задаче, attach его разорвёт
+            nodes.clear();
+            list.forEach([this](const task& t) { add(t); });
+        }
+    }
+
+    void ensure(const TaskList& list) {
+        if (!builtFor(list)) rebuild(list);
+    }
+
+    // Переход from -> to одной правкой: before - задача до неё, after - после
+    // (nullptr при создании и удалении). Если дерево не соответствует from,
+    // оно не трогается и будет перестроено при следующем запросе.
+    void apply(const TaskList& from, const TaskList& to, const task* before, const task* after) {
+        if (!builtFor(from)) return;
+        if (before) remove(*before);
+        if (after) add(*after);
+        version = to;
+    }
+
+private:
+    struct Node {
+        string parent;         // пусто - корень
+        Node* up = nullptr;    // узел родителя (адреса в unordered_map стабильны)
+        size_t tasks = 0;      // задач с этим id (0 - узел держится только ради детей)
+        size_t children = 0;
+        Rollup rollup;
+        multiset<string> dues; // сроки собственных открытых задач и ближайшие сроки детей
+    };
+
+    static string openDue(const task& t) {
+        return !t.done && isValidDueDate(t.due) ? t.due : string();
+    }
+
+    // Сдвиг счётчиков узла и всех предков на dOpen/dDone; в dues узла
+    // срок oldDue заменяется на newDue. Дальше по пути заменяется уже прежний
+    // ближайший срок узла на новый, пока он меняется.
+    static void propagate(Node* node, long dOpen, long dDone, string oldDue, string newDue) {
+        for (; node; node = node->up) {
+            node->rollup.open += static_cast<size_t>(dOpen);
+            node->rollup.done += static_cast<size_t>(dDone);
+            if (oldDue != newDue) {
+                if (!oldDue.empty()) node->dues.erase(node->dues.find(oldDue));
+                if (!newDue.empty()) node->dues.insert(newDue);
+                oldDue = std::move(node->rollup.earliestDue);
+                node->rollup.earliestDue = node->dues.empty() ? string() : *node->dues.begin();
+                newDue = node->rollup.earliestDue;
+            }
+            else if (dOpen == 0 && dDone == 0) {
+                return;
+            }
+        }
+    }
+
+    // родитель, образующий цикл, игнорируется: узел остаётся корнем
+    void attach(Node& node, const string& parent) {
+        if (parent.empty()) return;
+        auto it = nodes.find(parent);
+        if (it != nodes.end()) {
+            for (const Node* cur = &it->second; cur; cur = cur->up) {
+                if (cur == &node) return;
+            }
+        }
+        Node& up = it != nodes.end() ? it->second : nodes[parent];
+        node.parent = parent;
+        node.up = &up;
+        ++up.children;
+        propagate(&up, static_cast<long>(node.rollup.open), static_cast<long>(node.rollup.done),
+            string(), node.rollup.earliestDue);
+    }
+
+    void detach(Node& node) {
+        if (!node.up) return;
+        propagate(node.up, -static_cast<long>(node.rollup.open), -static_cast<long>(node.rollup.done),
+            node.rollup.earliestDue, string());
+        --node.up->children;
+        node.up = nullptr;
+        string parent = std::move(node.parent);
+        node.parent.clear();
+        prune(parent);
+    }
+
+    // удаление узлов без задач и детей вверх по пути
+    void prune(string id) {
+        while (!id.empty()) {
+            auto it = nodes.find(id);
+            if (it == nodes.end() || it->second.tasks > 0 || it->second.children > 0) return;
+            string parent = std::move(it->second.parent);
+            if (it->second.up) --it->second.up->children;
+            nodes.erase(it);
+            id = std::move(parent);
+        }
+    }
+
+    unordered_map<string, Node> nodes;
+    TaskList version;
+};
+
+// позиция первой задачи с этим id; false, если такой нет
+bool FindTask(const TaskList& list, const string& id, size_t& pos) {
+    pos = 0;
+    return !list.forEachWhile([&](const task& t) {
+        if (t.id == id) return false;
+        ++pos;
+        return true;
+    });
+}
+
+// Удаление задачи на позиции pos одной версией списка. Подзадачи удалённой
+// задачи переходят к её родителю (или на верхний уровень): иначе они остались бы
+// под её id и достались бы задаче, которая потом получит этот id. Если задач
+// с этим id несколько, подзадачи остаются на месте. moved - сколько перенесено.
+TaskList EraseTask(const TaskList& list, size_t pos, TaskTree& tree, size_t& moved) {
+    const task& removed = list[pos];
+    size_t sameId = 0;
+    vector<size_t> children;
+    size_t k = 0;
+    list.forEach([&](const task& t) {
+        if (t.id == removed.id) ++sameId;
+        else if (t.parent == removed.id) children.push_back(k);
+        ++k;
+    });
+    moved = 0;
+    TaskList cur = list;
+    if (sameId == 1) {
+        for (size_t child : children) {
+            task edited = cur[child];
+            edited.parent = removed.parent == edited.id ? string() : removed.parent;
+            TaskList next = cur.set(child, edited);
+            tree.apply(cur, next, &cur[child], &edited);
+            cur = next;
+            ++moved;
+        }
+    }
+    TaskList next = cur.erase(pos);
+    tree.apply(cur, next, &removed, nullptr);
+    return next;
+}
+
+void PrintProgress(const TaskTree& tree, const string& id) {
+    const TaskTree::Rollup* r = tree.rollup(id);
+    if (!r) {
+        cout << "Задача №" << id << " не найдена." << endl;
+        return;
+    }
+    size_t total = r->open + r->done;
+    cout << "Задача №" << id << " и подзадачи: всего " << total
+        << ", выполнено " << r->done << ", открыто " << r->open;
+    if (total > 0) cout << " (" << r->done * 100 / total << "% готово)";
+    cout << endl;
+    if (r->earliestDue.empty()) cout << "Открытых задач со сроком нет." << endl;
+    else cout << "Ближайший срок среди открытых: " << r->earliestDue << endl;
+}
+
 bool checkAgree(bool& is_agree) {
     string temp;
     while (true) {
@@ -469,10 +3136,36 @@ void RefactorTask(task& T) {
 
 // ===== Главное меню =====
 
-void Start(vector<task>& list_of_tasks) {
+void Start(TaskStore& store) {
     string filename = "data.json";
+    string archiveName = "archive.dat";
+    string viewsName = "views.cfg";
+    AsyncSaver saver(filename);
+    TaskIndexes indexes;
+    indexes.request(store.current());
+    // дерево подзадач строится при первом запросе, дальше обновляется по каждой
+    // правке; после отмены, импорта и архивации перестраивается при запросе
+    TaskTree tree;
+    // новую версию списка - на запись и на построение индексов
+    auto published = [&]() {
+        saver.publish(store.current());
+        indexes.request(store.current());
+    };
+    // перед выходом дожидаемся последней записи и сообщаем о сбое
+    auto finishSaving = [&saver]() {
+        saver.flush();
+        string saveError = saver.takeError();
+        if (!saveError.empty()) {
+            cerr << saveError << endl;
+        }
+    };
     int choose;
     while (true) {
+        string saveError = saver.takeError();
+        if (!saveError.empty()) {
+            cerr << saveError << endl;
+        }
+
         cout << "\nВведите число:" << endl;
         cout << "\t1 - создать задачу" << endl;
         cout << "\t2 - удалить задачу" << endl;
@@ -480,25 +3173,38 @@ void Start(vector<task>& list_of_tasks) {
         cout << "\t4 - фильтр по группе" << endl;
         cout << "\t5 - отчет о просроченных задачах" << endl;
         cout << "\t6 - просмотр всех задач" << endl;
+        cout << "\t7 - отменить последнее изменение" << endl;
+        cout << "\t8 - повторить отменённое изменение" << endl;
+        cout << "\t9 - импорт задач из файла (.csv, .ndjson, .json)" << endl;
+        cout << "\t10 - экспорт задач в файл (.csv, .ndjson, .json)" << endl;
+        cout << "\t11 - перенести выполненные задачи в архив" << endl;
+        cout << "\t12 - поиск в архиве" << endl;
+        cout << "\t13 - режим наблюдения (сохранённые представления)" << endl;
+        cout << "\t14 - поиск по слову в названии" << endl;
+        cout << "\t15 - создать подзадачу" << endl;
+        cout << "\t16 - прогресс задачи с подзадачами" << endl;
+        cout << "\t17 - сменить родительскую задачу" << endl;
         cout << "\tЛюбой другой символ - выход" << endl;
 
         if (!(cin >> choose)) {
             cout << "Завершение работы." << endl;
+            finishSaving();
             return;
         }
 
+        // версия списка на момент выбора пункта: отчёты читают её,
+        // даже если параллельно появляются новые версии
+        const TaskList list_of_tasks = store.current();
+
         switch (choose) {
         case 1: {
             task temp;
-            if (list_of_tasks.empty()) {
-                temp.id = "1";
-            }
-            else {
-                temp.id = to_string(list_of_tasks.size() + 1);
-            }
+            temp.id = to_string(list_of_tasks.maxNumericId() + 1);
             CreateTask(temp);
-            list_of_tasks.push_back(temp);
-            saveAllTasks(filename, list_of_tasks);
+            TaskList next = list_of_tasks.pushBack(temp);
+            store.commit(next);
+            tree.apply(list_of_tasks, next, nullptr, &temp);
+            published();
             break;
         }
         case 2: {
@@ -514,10 +3220,13 @@ void Start(vector<task>& list_of_tasks) {
                 cout << "Введен неверный id задачи." << endl;
                 break;
             }
-            auto it = list_of_tasks.begin() + (pop - 1);
-            list_of_tasks.erase(it);
-            saveAllTasks(filename, list_of_tasks);
+            size_t moved = 0;
+            store.commit(EraseTask(list_of_tasks, pop - 1, tree, moved));
+            published();
             cout << "Задача удалена." << endl;
+            if (moved > 0) {
+                cout << "Подзадач перенесено к родителю удалённой задачи: " << moved << endl;
+            }
             break;
         }
         case 3: {
@@ -533,8 +3242,12 @@ void Start(vector<task>& list_of_tasks) {
                 cout << "Введен неверный id задачи." << endl;
                 break;
             }
-            RefactorTask(list_of_tasks[pop - 1]);
-            saveAllTasks(filename, list_of_tasks);
+            task edited = list_of_tasks[pop - 1];
+            RefactorTask(edited);
+            TaskList next = list_of_tasks.set(pop - 1, edited);
+            store.commit(next);
+            tree.apply(list_of_tasks, next, &list_of_tasks[pop - 1], &edited);
+            published();
             cout << "Изменения сохранены." << endl;
             break;
         }
@@ -546,7 +3259,7 @@ void Start(vector<task>& list_of_tasks) {
             cout << "Введите название группы для фильтрации:" << endl;
             string grp;
             cin >> grp;
-            PrintByGroup(list_of_tasks, grp);
+            QueryByGroup(list_of_tasks, grp, indexes);
             break;
         }
         case 5: {
@@ -557,7 +3270,7 @@ void Start(vector<task>& list_of_tasks) {
             cout << "Для отчета о просроченных введите сегодняшнюю дату (YYYY-MM-DD):" << endl;
             string today;
             cin >> today;
-            PrintOverdue(list_of_tasks, today);
+            QueryOverdue(list_of_tasks, today, indexes);
             break;
         }
         case 6: {
@@ -568,20 +3281,277 @@ void Start(vector<task>& list_of_tasks) {
             PrintTask(list_of_tasks);
             break;
         }
+        case 7: {
+            if (!store.undo()) {
+                cout << "Отменять нечего." << endl;
+                break;
+            }
+            published();
+            cout << "Последнее изменение отменено." << endl;
+            break;
+        }
+        case 8: {
+            if (!store.redo()) {
+                cout << "Повторять нечего." << endl;
+                break;
+            }
+            published();
+            cout << "Изменение повторено." << endl;
+            break;
+        }
+        case 9: {
+            cout << "Введите имя файла для импорта:" << endl;
+            string from;
+            cin >> from;
+            TaskFormat format;
+            if (!formatFromName(from, format)) {
+                cout << "Неизвестный формат файла, ожидается .csv, .ndjson или .json" << endl;
+                break;
+            }
+            ifstream in(from, ios::binary);
+            if (!in.is_open()) {
+                cout << "Не удалось открыть файл для чтения!" << endl;
+                break;
+            }
+            vector<task> imported;
+            ImportStats stats = importTasks(in, format, [&imported](task& t) {
+                imported.push_back(std::move(t));
+            });
+            if (stats.imported > 0) {
+                // весь импорт - одна версия, отменяется одним шагом
+                store.commit(appendImported(list_of_tasks, std::move(imported)));
+                published();
+            }
+            cout << "Импортировано задач: " << stats.imported
+                << ", отклонено записей: " << stats.rejected << endl;
+            break;
+        }
+        case 10: {
+            cout << "Введите имя файла для экспорта:" << endl;
+            string to;
+            cin >> to;
+            if (exportTasks(to, list_of_tasks)) {
+                cout << "Экспортировано задач: " << list_of_tasks.size() << endl;
+            }
+            break;
+        }
+        case 11: {
+            cout << "В архив попадут выполненные задачи со сроком раньше даты (YYYY-MM-DD):" << endl;
+            string before;
+            cin >> before;
+            if (!isValidDueDate(before)) {
+                cout << "Некорректная дата." << endl;
+                break;
+            }
+            TaskList remaining;
+            long moved = archiveCompleted(list_of_tasks, before, archiveName, remaining);
+            if (moved < 0) {
+                cout << "Не удалось записать архив, задачи остались в списке." << endl;
+                break;
+            }
+            if (moved > 0) {
+                // перенос не отменяется: иначе задачи оказались бы и в списке, и в архиве
+                store.reset(remaining);
+                published();
+            }
+            cout << "Перенесено в архив задач: " << moved << endl;
+            break;
+        }
+        case 12: {
+            cout << "Введите группу (- для любой):" << endl;
+            string grp;
+            cin >> grp;
+            cout << "Введите начало и конец периода по сроку (YYYY-MM-DD YYYY-MM-DD, - без ограничения):" << endl;
+            string from, to;
+            cin >> from >> to;
+            if (grp == "-") grp.clear();
+            if (from == "-") from.clear();
+            if (to == "-") to.clear();
+            size_t found = queryArchive(archiveName, grp, from, to, PrintTaskLine);
+            cout << "Найдено в архиве задач: " << found << endl;
+            break;
+        }
+        case 13: {
+            vector<SavedView> views = loadViews(viewsName);
+            for (const auto& view : views) {
+                cout << view.name << ": группа " << (view.group.empty() ? "любая" : view.group)
+                    << (view.overdueOnly ? ", только просроченные" : "") << endl;
+            }
+            while (true) {
+                bool is_agree = false;
+                cout << "Добавить представление? (y/n)" << endl;
+                checkAgree(is_agree);
+                if (!is_agree) break;
+                SavedView view;
+                cout << "Введите имя представления" << endl;
+                cin >> view.name;
+                cout << "Введите группу (- для любой)" << endl;
+                cin >> view.group;
+                if (view.group == "-") view.group.clear();
+                cout << "Показывать только просроченные на сегодня? (y/n)" << endl;
+                checkAgree(view.overdueOnly);
+                views.push_back(std::move(view));
+                saveViews(viewsName, views);
+            }
+            if (views.empty()) {
+                cout << "Нет ни одного представления." << endl;
+                break;
+            }
+            // наблюдаем за файлом на диске, поэтому сначала дописываем свои изменения
+            saver.flush();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            WatchViews(filename, views);
+            // файл мог измениться извне: перечитываем его, иначе следующая правка
+            // перезаписала бы чужие изменения старой версией списка
+            ifstream file(filename);
+            if (!file.is_open()) {
+                cerr << "Не удалось перечитать " << filename << ", список не изменён." << endl;
+                break;
+            }
+            vector<task> reloaded;
+            readTasksJson(file, [&reloaded](task& t) { reloaded.push_back(std::move(t)); });
+            bool same = reloaded.size() == list_of_tasks.size();
+            for (size_t i = 0; same && i < reloaded.size(); ++i) {
+                same = sameTask(reloaded[i], list_of_tasks[i]);
+            }
+            if (!same) {
+                // файл уже содержит эту версию, поэтому только индексы, без записи
+                store.reset(TaskList::fromVector(std::move(reloaded)));
+                indexes.request(store.current());
+                cout << "Список перечитан из " << filename
+                    << " с внешними изменениями, история отмены очищена." << endl;
+            }
+            break;
+        }
+        case 14: {
+            if (list_of_tasks.empty()) {
+                cout << "Список задач пуст." << endl;
+                break;
+            }
+            cout << "Введите слово для поиска:" << endl;
+            string word;
+            cin >> word;
+            QueryByWord(list_of_tasks, word, indexes);
+            break;
+        }
+        case 15: {
+            if (list_of_tasks.empty()) {
+                cout << "Список задач пуст, сначала создайте задачу." << endl;
+                break;
+            }
+            PrintTask(list_of_tasks);
+            cout << "Введите id задачи, к которой добавляется подзадача:" << endl;
+            string parent;
+            cin >> parent;
+            tree.ensure(list_of_tasks);
+            if (!tree.hasTask(parent)) {
+                cout << "Задача с таким id не найдена." << endl;
+                break;
+            }
+            if (tree.taskCount(parent) > 1) {
+                cout << "Задач с id " << parent << " несколько, выберите задачу с уникальным id." << endl;
+                break;
+            }
+            task temp;
+            temp.id = to_string(list_of_tasks.maxNumericId() + 1);
+            temp.parent = parent;
+            CreateTask(temp);
+            TaskList next = list_of_tasks.pushBack(temp);
+            store.commit(next);
+            tree.apply(list_of_tasks, next, nullptr, &temp);
+            published();
+            break;
+        }
+        case 16: {
+            if (list_of_tasks.empty()) {
+                cout << "Список задач пуст." << endl;
+                break;
+            }
+            cout << "Введите id задачи:" << endl;
+            string id;
+            cin >> id;
+            tree.ensure(list_of_tasks);
+            PrintProgress(tree, id);
+            break;
+        }
+        case 17: {
+            if (list_of_tasks.empty()) {
+                cout << "Изменять нечего, попробуйте добавить что-то." << endl;
+                break;
+            }
+            PrintTask(list_of_tasks);
+            cout << "Введите id задачи, которую нужно перенести" << endl;
+            string id;
+            cin >> id;
+            tree.ensure(list_of_tasks);
+            size_t pos = 0;
+            if (!FindTask(list_of_tasks, id, pos)) {
+                cout << "Задача с таким id не найдена." << endl;
+                break;
+            }
+            if (tree.taskCount(id) > 1) {
+                cout << "Задач с id " << id << " несколько, перенос невозможен." << endl;
+                break;
+            }
+            cout << "Введите id новой родительской задачи (- для верхнего уровня):" << endl;
+            string parent;
+            cin >> parent;
+            if (parent == "-") parent.clear();
+            task edited = list_of_tasks[pos];
+            if (!parent.empty() && !tree.hasTask(parent)) {
+                cout << "Задача с таким id не найдена." << endl;
+                break;
+            }
+            if (!parent.empty() && tree.taskCount(parent) > 1) {
+                cout << "Задач с id " << parent << " несколько, выберите задачу с уникальным id." << endl;
+                break;
+            }
+            if (!parent.empty() && !tree.canAttach(edited.id, parent)) {
+                cout << "Нельзя: задача " << parent << " является подзадачей переносимой." << endl;
+                break;
+            }
+            edited.parent = parent;
+            TaskList next = list_of_tasks.set(pos, edited);
+            store.commit(next);
+            tree.apply(list_of_tasks, next, &list_of_tasks[pos], &edited);
+            published();
+            cout << "Изменения сохранены." << endl;
+            break;
+        }
         default:
             cout << "Выход из программы." << endl;
+            finishSaving();
             return;
         }
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
     setlocale(LC_ALL, "Ru-ru");
+    if (argc == 4 && string(argv[1]) == "convert") {
+        return convertTasks(argv[2], argv[3]);
+    }
+    if (argc == 3 && string(argv[1]) == "archive") {
+        return archiveFile("data.json", "archive.dat", argv[2]);
+    }
+    if (argc >= 4 && string(argv[1]) == "merge") {
+        return mergeTaskFiles(argv[2], vector<string>(argv + 3, argv + argc));
+    }
+    if (argc == 2 && string(argv[1]) == "watch") {
+        vector<SavedView> views = loadViews("views.cfg");
+        if (views.empty()) {
+            cerr << "Нет сохранённых представлений, добавьте их через пункт 13 меню." << endl;
+            return 1;
+        }
+        WatchViews("data.json", views);
+        return 0;
+    }
     vector<task> list_of_tasks;
     string name = "data.json";
 
     readFile(name, list_of_tasks);
-    Start(list_of_tasks);
+    TaskStore store(TaskList::fromVector(std::move(list_of_tasks)));
+    Start(store);
 
     return 0;
 }
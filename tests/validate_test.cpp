@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 #include <vector>
 #include <string>
+#include <sstream>
 #include "task_manager.h"  
 
 using namespace std;
@@ -173,6 +174,489 @@ TEST(IntegrationTest, FullCycle) {
 
 
 
+TEST(AsyncSaverTest, PublishAndFlush) {
+    vector<task> tasks = {
+        {"1", "low", "Задача1", "2025-12-25", "work", false},
+        {"2", "high", "Задача2", "2025-12-26", "home", true}
+    };
+    {
+        AsyncSaver saver("test_async.json");
+        TaskList list = TaskList::fromVector(tasks);
+        saver.publish(list);
+        saver.publish(list.erase(1));  // последний снимок перекрывает предыдущий
+        saver.flush();
+        EXPECT_TRUE(saver.takeError().empty());
+    }
+
+    vector<task> saved;
+    readFile("test_async.json", saved);
+    ASSERT_EQ(saved.size(), 1);
+    EXPECT_EQ(saved[0].title, "Задача1");
+}
+
+
+
+TEST(TaskListTest, VersionsAreIndependent) {
+    TaskList v1 = TaskList::fromVector({
+        {"1", "low", "Задача1", "2025-12-25", "work", false},
+        {"2", "mid", "Задача2", "2025-12-26", "work", false},
+        {"3", "high", "Задача3", "2025-12-27", "home", true}
+    });
+    TaskList v2 = v1.erase(0);
+    task changed = v2[0];
+    changed.title = "Изменена";
+    TaskList v3 = v2.set(0, changed).pushBack({"4", "low", "Задача4", "2025-12-28", "", false});
+
+    ASSERT_EQ(v1.size(), 3);
+    EXPECT_EQ(v1[0].id, "1");
+    EXPECT_EQ(v1[1].title, "Задача2");
+    ASSERT_EQ(v2.size(), 2);
+    EXPECT_EQ(v2[0].title, "Задача2");
+    ASSERT_EQ(v3.size(), 3);
+    EXPECT_EQ(v3[0].title, "Изменена");
+    EXPECT_EQ(v3[2].id, "4");
+}
+
+TEST(TaskStoreTest, UndoRedo) {
+    TaskStore store;
+    EXPECT_FALSE(store.undo());
+    store.commit(store.current().pushBack({"1", "low", "Задача1", "2025-12-25", "", false}));
+    store.commit(store.current().pushBack({"2", "low", "Задача2", "2025-12-26", "", false}));
+    EXPECT_EQ(store.current().size(), 2);
+
+    EXPECT_TRUE(store.undo());
+    EXPECT_EQ(store.current().size(), 1);
+    EXPECT_TRUE(store.undo());
+    EXPECT_TRUE(store.current().empty());
+    EXPECT_TRUE(store.redo());
+    EXPECT_EQ(store.current().size(), 1);
+
+    // новая правка после отмены сбрасывает стек повтора
+    store.commit(store.current().erase(0));
+    EXPECT_FALSE(store.redo());
+}
+
+
+
+TEST(ImportTest, CsvQuotedFieldsAndErrors) {
+    istringstream in(
+        "id,title,due,priority,group,done\n"
+        "1,\"Купить, молоко\",2025-12-25,low,быт,false\n"
+        "2,\"две\nстроки \"\"в кавычках\"\"\",2025-12-20,high,work,true\n"
+        "3,плохая дата,2025-02-30,low,,false\n"
+        "4,плохой приоритет,2025-02-03,urgent,,false\n");
+    vector<task> tasks;
+    stringstream errors;
+    auto* old = cerr.rdbuf(errors.rdbuf());
+    ImportStats stats = importTasks(in, TaskFormat::Csv, [&tasks](task& t) { tasks.push_back(t); });
+    cerr.rdbuf(old);
+
+    EXPECT_EQ(stats.imported, 2);
+    EXPECT_EQ(stats.rejected, 2);
+    // вторая запись занимает строки 3-4, ошибки - в строках 5 и 6
+    EXPECT_NE(errors.str().find("Строка 5:"), string::npos);
+    EXPECT_NE(errors.str().find("Строка 6:"), string::npos);
+    ASSERT_EQ(tasks.size(), 2);
+    EXPECT_EQ(tasks[0].title, "Купить, молоко");
+    EXPECT_EQ(tasks[1].title, "две\nстроки \"в кавычках\"");
+    EXPECT_TRUE(tasks[1].done);
+}
+
+TEST(ImportTest, ConvertRefusesSameFile) {
+    const string name = "convert_same_test.json";
+    {
+        ofstream out(name);
+        writeTaskJson(out, {"1", "low", "Задача", "2025-01-01", "", false}, true);
+    }
+    EXPECT_EQ(convertTasks(name, name), 1);
+    vector<task> tasks;
+    readFile(name, tasks);
+    EXPECT_EQ(tasks.size(), 1);
+    remove(name.c_str());
+}
+
+TEST(ImportTest, NdjsonRoundTrip) {
+    task original = {"5", "mid", "Задача \"5\"", "2025-12-31", "home", true};
+    ostringstream out;
+    writeTaskNdjson(out, original);
+    istringstream in(out.str() + "не json\n");
+
+    vector<task> tasks;
+    ImportStats stats = importTasks(in, TaskFormat::Ndjson, [&tasks](task& t) { tasks.push_back(t); });
+    EXPECT_EQ(stats.rejected, 1);
+    ASSERT_EQ(tasks.size(), 1);
+    EXPECT_EQ(tasks[0].id, "5");
+    EXPECT_EQ(tasks[0].title, "Задача \"5\"");
+    EXPECT_EQ(tasks[0].priority, "mid");
+    EXPECT_TRUE(tasks[0].done);
+}
+
+
+
+TEST(ArchiveTest, LzRoundTrip) {
+    string text;
+    for (int i = 0; i < 200; ++i) text += "{\"id\":\"" + to_string(i) + "\",\"group\":\"work\"}\n";
+    string packed = lzCompress(text);
+    EXPECT_LT(packed.size(), text.size() / 2);
+
+    string restored;
+    ASSERT_TRUE(lzDecompress(packed, text.size(), restored));
+    EXPECT_EQ(restored, text);
+    EXPECT_FALSE(lzDecompress(packed, text.size() - 1, restored));  // размер не совпадает
+}
+
+TEST(ArchiveTest, MoveCompletedAndQuery) {
+    remove("test_archive.dat");
+    TaskList list = TaskList::fromVector({
+        {"1", "low", "Задача1", "2025-11-01", "work", true},   // в архив
+        {"2", "mid", "Задача2", "2025-11-02", "work", false},  // не выполнена
+        {"3", "high", "Задача3", "2025-12-30", "home", true},  // срок позже порога
+        {"4", "low", "Задача4", "2025-10-15", "home", true}    // в архив
+    });
+    TaskList remaining;
+    EXPECT_EQ(archiveCompleted(list, "2025-12-01", "test_archive.dat", remaining), 2);
+    ASSERT_EQ(remaining.size(), 2);
+    EXPECT_EQ(remaining[0].id, "2");
+    EXPECT_EQ(remaining[1].id, "3");
+
+    vector<string> ids;
+    queryArchive("test_archive.dat", "home", "", "", [&ids](const task& t) { ids.push_back(t.id); });
+    ASSERT_EQ(ids.size(), 1);
+    EXPECT_EQ(ids[0], "4");
+    EXPECT_EQ(queryArchive("test_archive.dat", "", "2025-11-01", "2025-11-30", [](const task&) {}), 1);
+}
+
+
+
+TEST(ArchiveTest, DamagedHeaderKeepsEarlierBlocks) {
+    const string name = "test_archive_damaged.dat";
+    remove(name.c_str());
+    // задача без приоритета тоже должна находиться в архиве
+    ASSERT_TRUE(appendArchiveBlocks(name, {{"1", "", "Задача1", "2025-01-01", "work", true}}));
+    uint64_t firstEnd = filesystem::file_size(name);
+    ASSERT_TRUE(appendArchiveBlocks(name, {{"2", "low", "Задача2", "2025-01-02", "work", true}}));
+    ASSERT_TRUE(appendArchiveBlocks(name, {{"3", "low", "Задача3", "2025-01-03", "work", true}}));
+    uint64_t size = filesystem::file_size(name);
+
+    // оборванный заголовок в конце - недописанный хвост, его можно обрезать
+    {
+        ofstream out(name, ios::binary | ios::app);
+        out << "TTA";
+    }
+    ASSERT_TRUE(appendArchiveBlocks(name, {{"4", "low", "Задача4", "2025-01-04", "work", true}}));
+    EXPECT_EQ(queryArchive(name, "", "", "", [](const task&) {}), 4);
+    size = filesystem::file_size(name);
+
+    // испорченный заголовок второго блока: дозапись отказывает и ничего не обрезает
+    {
+        fstream io(name, ios::binary | ios::in | ios::out);
+        io.seekp(static_cast<streamoff>(firstEnd));
+        io.put('X');
+    }
+    EXPECT_FALSE(appendArchiveBlocks(name, {{"5", "low", "Задача5", "2025-01-05", "work", true}}));
+    EXPECT_EQ(filesystem::file_size(name), size);
+    vector<string> ids;
+    queryArchive(name, "", "", "", [&ids](const task& t) { ids.push_back(t.id); });
+    ASSERT_EQ(ids.size(), 1);
+    EXPECT_EQ(ids[0], "1");
+
+    // нереальный rawSize в заголовке не доходит до распаковки
+    {
+        fstream io(name, ios::binary | ios::in | ios::out);
+        io.seekp(4);
+        io.write("\xFF\xFF\xFF\x7F", 4);
+    }
+    vector<ArchiveBlock> blocks;
+    uint64_t tailOffset = 0;
+    bool corrupted = false;
+    ASSERT_TRUE(readArchiveIndex(name, blocks, tailOffset, corrupted));
+    EXPECT_TRUE(corrupted);
+    EXPECT_TRUE(blocks.empty());
+    remove(name.c_str());
+}
+
+TEST(ArchiveTest, LongGroupsAndBadDatesStayReadable) {
+    const string name = "test_archive_groups.dat";
+    remove(name.c_str());
+    vector<task> cold;
+    for (char c : string("abc")) {
+        cold.push_back({string(1, c), "low", "Задача", "2025-01-01", string(30000, c), true});
+    }
+    ASSERT_TRUE(appendArchiveBlocks(name, cold));
+    vector<ArchiveBlock> blocks;
+    uint64_t tailOffset = 0;
+    bool corrupted = false;
+    ASSERT_TRUE(readArchiveIndex(name, blocks, tailOffset, corrupted));
+    EXPECT_FALSE(corrupted);
+    EXPECT_EQ(queryArchive(name, string(30000, 'b'), "", "", [](const task&) {}), 1);
+
+    // некорректный срок не роняет архивацию, задача остаётся в списке
+    TaskList list = TaskList::fromVector({{"1", "low", "Задача", "abcd-ef-gh", "", true}});
+    TaskList remaining;
+    EXPECT_EQ(archiveCompleted(list, "2025-12-01", name, remaining), 0);
+    EXPECT_EQ(remaining.size(), 1);
+    remove(name.c_str());
+}
+
+TEST(WatchTest, DiffUpdatesViewsIncrementally) {
+    unordered_map<string, task> known;
+    vector<task> fresh = {
+        {"1", "low", "Задача1", "2025-12-01", "work", false},
+        {"2", "mid", "Задача2", "2025-12-30", "work", false},
+        {"3", "high", "Задача3", "2025-12-01", "home", false}
+    };
+    TaskDelta first = diffTasks(known, fresh);
+    EXPECT_EQ(first.added.size(), 3);
+
+    SavedView overdue;
+    overdue.name = "просроченные";
+    overdue.overdueOnly = true;
+    overdue.rebuild(known, "2025-12-15");
+    EXPECT_EQ(overdue.rows.size(), 2);
+
+    fresh = {
+        {"1", "low", "Задача1", "2025-12-01", "work", true},   // выполнена
+        {"2", "mid", "Задача2", "2025-12-30", "work", false},  // без изменений
+        {"4", "low", "Задача4", "2025-12-10", "home", false}   // новая, задача 3 удалена
+    };
+    TaskDelta delta = diffTasks(known, fresh);
+    EXPECT_EQ(delta.added.size(), 1);
+    EXPECT_EQ(delta.changed.size(), 1);
+    EXPECT_EQ(delta.removed.size(), 1);
+
+    ApplyDelta(overdue, delta, "2025-12-15");
+    ASSERT_EQ(overdue.rows.size(), 1);
+    EXPECT_EQ(overdue.rows.begin()->second.id, "4");
+}
+
+
+
+TEST(MergeTest, SortsDeduplicatesAndRemapsIds) {
+    {
+        ofstream a("test_merge_a.ndjson");
+        writeTaskNdjson(a, {"1", "low", "Задача1", "2025-12-20", "work", false});
+        writeTaskNdjson(a, {"2", "mid", "Задача2", "2025-12-01", "home", false});
+        ofstream b("test_merge_b.ndjson");
+        writeTaskNdjson(b, {"1", "low", "Задача1", "2025-12-20", "work", false});  // дубликат
+        writeTaskNdjson(b, {"2", "high", "Задача3", "2025-12-05", "work", true});  // id занят
+    }
+    ASSERT_EQ(mergeTaskFiles("test_merge_out.ndjson", {"test_merge_a.ndjson", "test_merge_b.ndjson"}), 0);
+
+    ifstream in("test_merge_out.ndjson");
+    vector<task> merged;
+    importTasks(in, TaskFormat::Ndjson, [&merged](task& t) { merged.push_back(t); });
+    ASSERT_EQ(merged.size(), 3);
+    EXPECT_EQ(merged[0].group, "home");
+    EXPECT_EQ(merged[1].title, "Задача3");
+    EXPECT_EQ(merged[1].id, "3");  // больше максимального id входов
+    EXPECT_EQ(merged[2].title, "Задача1");
+}
+
+
+
+TEST(MergeTest, RejectedRecordsNameTheirFile) {
+    {
+        ofstream a("test_merge_a.ndjson");
+        writeTaskNdjson(a, {"1", "low", "Задача1", "2025-12-20", "work", false});
+        ofstream b("test_merge_b.ndjson");
+        writeTaskNdjson(b, {"2", "low", "Задача2", "2025-12-01", "work", false});
+        b << "{\"id\":\"3\",\"priority\":\"low\"}\n";
+    }
+    stringstream errors;
+    auto* old = cerr.rdbuf(errors.rdbuf());
+    mergeTaskFiles("test_merge_out.ndjson", {"test_merge_a.ndjson", "test_merge_b.ndjson"});
+    cerr.rdbuf(old);
+    EXPECT_NE(errors.str().find("test_merge_b.ndjson: Строка 2:"), string::npos);
+}
+
+TEST(MergeTest, ParentFollowsRemappedIds) {
+    {
+        ofstream a("test_merge_a.ndjson");
+        writeTaskNdjson(a, {"2", "low", "ProjA", "2025-12-01", "work", false});
+        ofstream b("test_merge_b.ndjson");
+        writeTaskNdjson(b, {"2", "low", "ProjB", "2025-12-02", "work", false});        // id занят
+        writeTaskNdjson(b, {"3", "low", "ChildOfB", "2025-12-03", "work", false, "2"});
+    }
+    ASSERT_EQ(mergeTaskFiles("test_merge_out.ndjson", {"test_merge_a.ndjson", "test_merge_b.ndjson"}), 0);
+
+    ifstream in("test_merge_out.ndjson");
+    vector<task> merged;
+    importTasks(in, TaskFormat::Ndjson, [&merged](task& t) { merged.push_back(t); });
+    ASSERT_EQ(merged.size(), 3);
+    EXPECT_EQ(merged[0].title, "ProjA");
+    EXPECT_EQ(merged[0].id, "2");
+    EXPECT_EQ(merged[1].title, "ProjB");
+    EXPECT_EQ(merged[1].id, "4");
+    EXPECT_EQ(merged[2].title, "ChildOfB");
+    EXPECT_EQ(merged[2].parent, "4");
+}
+
+
+
+TEST(IndexTest, IndexedQueriesMatchScan) {
+    vector<task> tasks = {
+        {"1", "low", "Купить молоко", "2020-01-05", "home", false},
+        {"2", "mid", "Отчёт за квартал", "2020-01-01", "work", false},
+        {"3", "high", "купить хлеб", "2020-01-02", "home", true},
+        {"4", "low", "Отчёт", "2099-01-01", "work", false}
+    };
+    TaskList list = TaskList::fromVector(tasks);
+    TaskIndexes indexes;
+    indexes.request(list);
+    while (!indexes.group.get(list) || !indexes.due.get(list) || !indexes.search.get(list)) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    auto capture = [](const function<void()>& f) {
+        stringstream out;
+        auto* old = cout.rdbuf(out.rdbuf());
+        f();
+        cout.rdbuf(old);
+        return out.str();
+    };
+    TaskIndexes cold;  // индексы не запрошены: запросы идут простым просмотром
+    for (const string& group : { "home", "work", "none" }) {
+        EXPECT_EQ(capture([&] { QueryByGroup(list, group, indexes); }),
+                  capture([&] { QueryByGroup(list, group, cold); }));
+    }
+    EXPECT_EQ(capture([&] { QueryOverdue(list, "2021-01-01", indexes); }),
+              capture([&] { QueryOverdue(list, "2021-01-01", cold); }));
+
+    // регистр кириллицы не важен: находятся обе задачи
+    string indexed = capture([&] { QueryByWord(list, "КУПИТЬ", indexes); });
+    EXPECT_EQ(indexed, capture([&] { QueryByWord(list, "КУПИТЬ", cold); }));
+    EXPECT_NE(indexed.find("Купить молоко"), string::npos);
+    EXPECT_NE(indexed.find("купить хлеб"), string::npos);
+    EXPECT_EQ(indexed.find("Отчёт"), string::npos);
+    EXPECT_EQ(splitWords("Ёлка ЯБЛОКО, Tree"), vector<string>({ "ёлка", "яблоко", "tree" }));
+
+    // индекс другой версии не используется
+    TaskList edited = list.set(0, tasks[1]);
+    EXPECT_EQ(indexes.group.get(edited), nullptr);
+}
+
+
+
+TEST(SubtaskTest, RollupsFollowEdits) {
+    task project = {"1", "high", "Проект", "2025-03-01", "work", false};
+    task stage = {"2", "mid", "Этап", "2025-02-01", "work", false, "1"};
+    task step = {"3", "low", "Шаг", "2025-01-15", "work", false, "2"};
+    TaskList list = TaskList::fromVector({ project, stage, step });
+    TaskTree tree;
+    tree.ensure(list);
+    ASSERT_NE(tree.rollup("1"), nullptr);
+    EXPECT_EQ(tree.rollup("1")->open, 3);
+    EXPECT_EQ(tree.rollup("1")->earliestDue, "2025-01-15");
+
+    // шаг выполнен: ближайший срок проекта переходит к этапу
+    task doneStep = step;
+    doneStep.done = true;
+    TaskList next = list.set(2, doneStep);
+    tree.apply(list, next, &list[2], &doneStep);
+    EXPECT_TRUE(tree.builtFor(next));
+    EXPECT_EQ(tree.rollup("1")->open, 2);
+    EXPECT_EQ(tree.rollup("1")->done, 1);
+    EXPECT_EQ(tree.rollup("1")->earliestDue, "2025-02-01");
+    EXPECT_EQ(tree.rollup("2")->done, 1);
+
+    // родитель не может оказаться в собственном поддереве
+    EXPECT_FALSE(tree.canAttach("1", "3"));
+    EXPECT_TRUE(tree.canAttach("3", "1"));
+
+    // удалённый этап: шаг остаётся под его id, из проекта оба уходят
+    TaskList last = next.erase(1);
+    tree.apply(next, last, &next[1], nullptr);
+    EXPECT_EQ(tree.rollup("1")->open, 1);
+    EXPECT_EQ(tree.rollup("1")->done, 0);
+    EXPECT_EQ(tree.rollup("1")->earliestDue, "2025-03-01");
+    EXPECT_FALSE(tree.hasTask("2"));
+    EXPECT_EQ(tree.rollup("2")->done, 1);
+}
+
+TEST(SubtaskTest, ParentSurvivesFormats) {
+    task child = {"2", "low", "Подзадача", "2025-01-01", "", false, "1"};
+    for (TaskFormat format : { TaskFormat::Json, TaskFormat::Csv, TaskFormat::Ndjson }) {
+        ostringstream out;
+        {
+            TaskStreamWriter writer(out, format);
+            writer.write(child);
+            writer.finish();
+        }
+        istringstream in(out.str());
+        vector<task> tasks;
+        importTasks(in, format, [&tasks](task& t) { tasks.push_back(t); });
+        ASSERT_EQ(tasks.size(), 1);
+        EXPECT_EQ(tasks[0].parent, "1");
+    }
+}
+
+TEST(SubtaskTest, IdsStayUniqueAndAmbiguousIdsAreRejected) {
+    TaskList list = TaskList::fromVector({
+        {"1", "low", "a", "", "", false},
+        {"2", "low", "b", "", "", false},
+        {"3", "low", "c", "", "", false}
+    });
+    list = list.erase(0);
+    // новый id больше всех существующих, а не size() + 1
+    EXPECT_EQ(list.maxNumericId() + 1, 4);
+    list = list.pushBack({"3", "low", "d", "", "", false});  // повтор из старого файла
+    EXPECT_EQ(list.maxNumericId(), 3);
+
+    TaskTree tree;
+    tree.ensure(list);
+    EXPECT_EQ(tree.taskCount("3"), 2);
+    EXPECT_FALSE(tree.canAttach("3", "2"));  // переносимая задача неоднозначна
+    EXPECT_FALSE(tree.canAttach("2", "3"));  // родитель неоднозначен
+}
+
+
+
+TEST(SubtaskTest, NewTaskDoesNotAdoptSubtasksOfDeletedOne) {
+    TaskList list = TaskList::fromVector({
+        {"1", "low", "A", "2025-01-01", "", false, "2"},  // A перенесена под B
+        {"2", "low", "B", "2025-01-02", "", false}
+    });
+    TaskTree tree;
+    tree.ensure(list);
+    size_t moved = 0;
+    list = EraseTask(list, 1, tree, moved);
+    EXPECT_EQ(moved, 1);
+    ASSERT_EQ(list.size(), 1);
+    EXPECT_EQ(list[0].parent, "");
+
+    task c = {to_string(list.maxNumericId() + 1), "low", "C", "2025-01-03", "", false};
+    TaskList next = list.pushBack(c);
+    tree.apply(list, next, nullptr, &c);
+    ASSERT_NE(tree.rollup(c.id), nullptr);
+    EXPECT_EQ(tree.rollup(c.id)->open, 1);  // у C нет чужих подзадач
+    tree.rebuild(next);
+    EXPECT_EQ(tree.rollup(c.id)->open, 1);
+
+    // ссылка на задачу вне списка (например, в архиве) тоже занимает id
+    list = TaskList::fromVector({{"1", "low", "A", "", "", false, "7"}});
+    EXPECT_EQ(list.maxNumericId(), 7);
+}
+
+TEST(SubtaskTest, ImportRenumbersTakenIdsAndTheirSubtasks) {
+    TaskList list = TaskList::fromVector({
+        {"1", "low", "a", "", "", false},
+        {"2", "low", "b", "", "", false}
+    });
+    list = appendImported(list, {
+        {"2", "low", "Проект", "", "", false},            // id занят в списке
+        {"", "low", "Без id", "", "", false},
+        {"5", "low", "Шаг", "", "", false, "2"},          // ссылается на импортированный 2
+        {"5", "low", "Повтор", "", "", false, "5"}        // повтор внутри импорта
+    });
+    ASSERT_EQ(list.size(), 6);
+    EXPECT_EQ(list[2].id, "6");  // больше всех id списка и импорта
+    EXPECT_EQ(list[3].id, "7");
+    EXPECT_EQ(list[4].id, "5");
+    EXPECT_EQ(list[4].parent, "6");
+    EXPECT_EQ(list[5].id, "8");
+    EXPECT_EQ(list[5].parent, "5");  // первая задача импорта с id 5
+}
+
 TEST(MenuTest, IdGeneration) {
     vector<task> empty_list;
     task first_task;